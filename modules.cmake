@@ -0,0 +1,29 @@
+# Application modules, everything but main(). Included by the application
+# and by the test suites (tests/), which provide their own main()
+
+set(SMART_IO_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+target_sources(app PRIVATE ${SMART_IO_DIR}/src/UART/UART.c ${SMART_IO_DIR}/src/sensors/adc.c ${SMART_IO_DIR}/src/sensors/adc_hal.c ${SMART_IO_DIR}/src/sensors/leds.c ${SMART_IO_DIR}/src/sensors/buttons.c ${SMART_IO_DIR}/src/sensors/rtdb.c ${SMART_IO_DIR}/src/sensors/events.c ${SMART_IO_DIR}/src/sensors/gestures.c ${SMART_IO_DIR}/src/sensors/gpio_bank.c ${SMART_IO_DIR}/src/sensors/pwm_leds.c ${SMART_IO_DIR}/src/sched/executive.c ${SMART_IO_DIR}/src/sched/stats.c ${SMART_IO_DIR}/src/sched/opmode.c ${SMART_IO_DIR}/src/diag/memtel.c ${SMART_IO_DIR}/src/diag/logctl.c)
+target_sources_ifdef(CONFIG_APP_SELFTEST app PRIVATE ${SMART_IO_DIR}/src/diag/selftest.c)
+target_sources_ifdef(CONFIG_APP_TRACE app PRIVATE ${SMART_IO_DIR}/src/diag/trace.c)
+target_sources_ifdef(CONFIG_APP_CAPTURE app PRIVATE ${SMART_IO_DIR}/src/sensors/capture.c)
+target_sources_ifdef(CONFIG_APP_REPLAY app PRIVATE ${SMART_IO_DIR}/src/sensors/replay.c)
+target_sources_ifdef(CONFIG_APP_RULES app PRIVATE ${SMART_IO_DIR}/src/sensors/rules.c)
+target_sources_ifdef(CONFIG_APP_PERSIST app PRIVATE ${SMART_IO_DIR}/src/config/persist.c)
+if(CONFIG_APP_REPLAY AND CONFIG_NATIVE_LIBRARY)
+  # File access runs on the host side of native_sim, with the host C library
+  target_sources(native_simulator INTERFACE ${SMART_IO_DIR}/src/sensors/replay_host.c)
+endif()
+if(CONFIG_APP_SELFTEST AND CONFIG_NATIVE_LIBRARY)
+  # Benchmark clock, the simulated time of native_sim stands still while it runs
+  target_sources(native_simulator INTERFACE ${SMART_IO_DIR}/src/diag/selftest_host.c)
+endif()
+target_include_directories(app PRIVATE ${SMART_IO_DIR}/src/UART ${SMART_IO_DIR}/src/sensors ${SMART_IO_DIR}/src/sched ${SMART_IO_DIR}/src/diag ${SMART_IO_DIR}/src/config)
+
+# Zero-heap mode: any allocator still referenced resolves to an undefined
+# __wrap_<name> symbol and fails the link
+if(CONFIG_APP_STATIC_MEMORY)
+  foreach(alloc malloc calloc realloc k_malloc k_calloc k_realloc k_aligned_alloc)
+    zephyr_link_libraries(-Wl,--wrap=${alloc})
+  endforeach()
+endif()
@@ -3,13 +3,32 @@
 #include "../sensors/adc.h"
 #include "../sensors/buttons.h"
 #include "../sensors/rtdb.h"
+#include "../sensors/events.h"
+#include "../sensors/gestures.h"
+#include "../sensors/pwm_leds.h"
+#include "../sensors/capture.h"
+#include "../sensors/replay.h"
+#include "../sensors/rules.h"
+#include "../sched/executive.h"
+#include "../sched/opmode.h"
+#include "../diag/memtel.h"
+#include "../diag/selftest.h"
+#include "../diag/trace.h"
+#include "../diag/logctl.h"
+#include "../config/persist.h"
 
-/* UART related variables */
-const struct device *uart_dev = DEVICE_DT_GET(UART_NODE);
-static uint8_t rx_buf[RXBUF_SIZE];        /* RX buffer, to store received data */
-//static uint8_t rx_chars[RXBUF_SIZE];    /* chars actually received  */
-volatile int uart_rxbuf_nchar = 0;        /* Number of chars currrntly on the rx buffer */
-volatile int uart_rxbuf_start = 0;
+LOG_MODULE_REGISTER(app_uart, CONFIG_APP_UART_LOG_LEVEL);
+
+/* UART sessions, one per UART device carrying the protocol */
+static struct uart_session_t uart_sessions[] = {
+    { .name = "host", .dev = DEVICE_DT_GET(UART_NODE) },
+#if DT_NODE_HAS_STATUS(UART_HMI_NODE, okay)
+    { .name = "hmi", .dev = DEVICE_DT_GET(UART_HMI_NODE) },
+#endif
+};
+BUILD_ASSERT(ARRAY_SIZE(uart_sessions) <= UART_MAX_SESSIONS, "too many UART sessions");
+
+K_THREAD_STACK_ARRAY_DEFINE(uart_session_stacks, UART_MAX_SESSIONS, UART_SESSION_STACK_SIZE);
 
 /* Struct for UART configuration. If using default values (check devicetree info) is not needed) */
 /* Dynamic configuration option, available if CONFIG_UART_USE_RUNTIME_CONFIGURE is ser (it is by defualt)*/
@@ -22,11 +41,69 @@ const struct uart_config uart_cfg = {
 		.flow_ctrl = UART_CFG_FLOW_CTRL_NONE
 };
 
-/* Command processing variables */
-static regex_t regex;
-static char* command_pattern = "^#(B[0-3]|L([0-3]|[0-3][0-1])|A(R|V))(2[5][0-5]|2[0-4][0-9]|[0-1][0-9]{2})!$";
+/* Command grammar: accepted argument forms after each opcode, separated by '|'.
+   Lowercase letters are character classes (see command_class_match()), '+'
+   repeats the previous class 1 to 16 times, anything else is literal */
+static const struct {
+    char opcode;
+    const char *forms;
+} command_forms[] = {
+    { 'B', "q" },
+    { 'L', "q|qb|A|Mbbbbbbbb" },
+    { 'A', "r" },
+    { 'E', "" },
+    { 'G', "|ldddd" },
+    { 'P', "q|q0dd|q100" },
+    { 'K', "qdddd" },
+    { 'Q', "qb+dddd" },
+    { 'J', "" },
+    { 'T', "u|uddddd" },
+    { 'S', "u|uR" },
+    { 'D', "u|uddddds" },
+    { 'M', "" },
+    { 'O', "|b" },
+    { 'R', "|b" },
+    { 'I', "" },
+    { 'H', "|R" },
+    { 'V', "|df" },
+    { 'Z', "" },
+    { 'C', "|Atdddd|T|D|S" },
+    { 'Y', "|P|S|R|E|D" },
+    { 'U', "|C|dd|ddAHddddaq|ddALddddaq|ddBqaq|ddEeqaq" },
+    { 'W', "|S|E" },
+};
+
+#define COMMAND_MAX_REPEAT 16   /* Max repetitions of a '+' class */
+
+/* Converts a fixed-width decimal field of a (validated) command to an integer */
+static int parse_digits(const uint8_t *field, int n_digits) {
+    int value = 0;
+    for(int i = 0; i < n_digits; i++) {
+        value = value * 10 + (field[i] - '0');
+    }
+    return value;
+}
+
+/* Hands the oldest contiguous block of the TX queue to the driver, tx_lock must be held */
+static void uart_tx_start(struct uart_session_t *session) {
+
+    if(session->tx_busy) {
+        return;
+    }
+
+    uint8_t *data;
+    uint32_t len = ring_buf_get_claim(&session->tx_ring, &data, UART_TX_QUEUE_SIZE);
+    if(len == 0) {
+        return;
+    }
 
-K_FIFO_DEFINE(uart_fifo);
+    if(uart_tx(session->dev, data, len, SYS_FOREVER_US) == 0) {
+        session->tx_busy = true;
+        session->tx_len = len;
+    } else {
+        ring_buf_get_finish(&session->tx_ring, 0);
+    }
+}
 
 /* UART callback implementation */
 /* Note that callback functions are executed in the scope of interrupt handlers. */
@@ -34,33 +111,67 @@ K_FIFO_DEFINE(uart_fifo);
 /* Should be kept as short and simple as possible. Heavier processing should be deferred to a task with suitable priority*/
 void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data)
 {
+    struct uart_session_t *session = user_data;
+    uint8_t *rx_buf = session->rx_buf;
     int err;
 
     switch (evt->type) {
 	
         case UART_TX_DONE:
-		    printk("UART_TX_DONE event \n\r");
-            break;
-
     	case UART_TX_ABORTED:
+            /* Release the bytes sent (all of them if aborted) and send the rest of the queue */
+            k_spinlock_key_t key = k_spin_lock(&session->tx_lock);
+            ring_buf_get_finish(&session->tx_ring, session->tx_len);
+            session->stats.tx_bytes += (evt->type == UART_TX_DONE) ? evt->data.tx.len : 0;
+            session->tx_busy = false;
+            uart_tx_start(session);
+            k_spin_unlock(&session->tx_lock, key);
+            k_sem_give(&session->tx_space);
 		    break;
     
 	    case UART_RX_RDY:
-            /* If input is equal to '#' we change the starting index of the command */
-            if(rx_buf[evt->data.rx.offset] == SOF_SYM) {
-                uart_rxbuf_start = evt->data.rx.offset; 
-            }
+            opmode_wake(WAKE_SRC_UART);
+            session->stats.rx_bytes += evt->data.rx.len;
 
-            /* Storing buffer into FIFO */
-            size_t FIFO_elem_size = sizeof(struct uart_data_item_t);
-            struct uart_data_item_t *item_ptr;
+            /* A chunk may hold a partial frame, a whole frame or several frames (e.g. a */
+            /*   host sending at full speed), so one item is queued per end of frame */
+            for(size_t i = 0; i < evt->data.rx.len; i++) {
+                int pos = evt->data.rx.offset + i;
 
-            item_ptr = k_malloc(FIFO_elem_size);
-            item_ptr->rx_buf_start = uart_rxbuf_start;
-            item_ptr->rx_buf_end = evt->data.rx.offset;
-            memcpy(item_ptr->rx_chars, rx_buf, RXBUF_SIZE);
+                /* If input is equal to '#' we change the starting index of the command */
+                if(rx_buf[pos] == SOF_SYM) {
+                    session->rx_start = pos;
+                }
+                if(rx_buf[pos] != EOF_SYM) {
+                    continue;
+                }
 
-            k_fifo_put(&uart_fifo, item_ptr);
+                /* Storing buffer into FIFO */
+                struct uart_data_item_t *item_ptr;
+
+                if(k_mem_slab_alloc(&session->frame_slab, (void **)&item_ptr, K_NO_WAIT) != 0) {
+                    session->stats.rx_dropped++;
+                    continue;
+                }
+                item_ptr->rx_buf_start = session->rx_start;
+                item_ptr->rx_buf_end = pos;
+                memcpy(item_ptr->rx_chars, rx_buf, RXBUF_SIZE);
+                /* The session index in the top bits keeps sequence numbers unique in the trace */
+                item_ptr->seq = (session->id << 12) | (session->rx_seq++ & 0xFFF);
+                item_ptr->rx_stamp = cycles_now();
+                item_ptr->lane = uart_command_lane(item_ptr);
+                TRACE(TRACE_EVT_UART_RX, item_ptr->seq);
+
+                struct uart_lane_t *lane = &session->lanes[item_ptr->lane];
+                k_fifo_put(&lane->fifo, item_ptr);
+                k_sem_give(&session->rx_items);
+                session->stats.frames++;
+
+                atomic_val_t depth = atomic_inc(&lane->depth) + 1;
+                if(depth > atomic_get(&lane->high_water)) {
+                    atomic_set(&lane->high_water, depth);
+                }
+            }
             
             break;
 
@@ -76,9 +187,9 @@ void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data)
 	    case UART_RX_DISABLED: 
             /* When the RX_BUFF becomes full RX is disabled automaticaly.  */
             /* It must be re-enabled manually for continuous reception */
-		    err = uart_rx_enable(uart_dev ,rx_buf,sizeof(rx_buf),RX_TIMEOUT);
+		    err = uart_rx_enable(dev ,session->rx_buf,sizeof(session->rx_buf),RX_TIMEOUT);
             if (err) {
-                printk("uart_rx_enable() error. Error code:%d\n\r",err);
+                LOG_ERR("%s: uart_rx_enable() error. Error code:%d", session->name, err);
                 exit(FATAL_ERR);                
             }
 		    break;
@@ -87,64 +198,247 @@ void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data)
 		    break;
 		
 	    default:
-            printk("UART: Unknown event \n\r");
+            LOG_WRN("Unknown event %d", evt->type);
 		    break;
     }
 
 }
 
-uint16_t uart_init() {
+/* Names of the command classes, indexed by UART_CMD_* */
+static const char *const uart_cmd_class_names[UART_N_CMD_CLASSES] = {
+    "B", "L READ", "L WRITE", "AR", "AV", "OTHER",
+};
+
+/* Command class of a frame, for the command latencies */
+static int uart_cmd_class(const uint8_t *command, uint16_t command_len, bool valid) {
+    if(!valid) {
+        return UART_CMD_OTHER;
+    }
+    switch(command[1]) {
+        case 'B':
+            return UART_CMD_BUTTON;
+        case 'L':
+            /* 'Lq' and 'LA' read, 'Lqb' and 'LM' write */
+            return command_len > 7 ? UART_CMD_LED_WRITE : UART_CMD_LED_READ;
+        case 'A':
+            return command[2] == 'R' ? UART_CMD_ADC_RAW : UART_CMD_ADC_VOLTS;
+        default:
+            return UART_CMD_OTHER;
+    }
+}
+
+static void uart_cmd_latency_reset(struct uart_session_t *session) {
+    for(int i = 0; i < UART_N_CMD_CLASSES; i++) {
+        struct uart_cmd_latency_t *lat = &session->cmd_latency[i];
+        stats_reset(&lat->wait_us);
+        stats_reset(&lat->service_us);
+        stats_hist_reset(&lat->wait_hist_us);
+        stats_hist_reset(&lat->service_hist_us);
+    }
+}
+
+/* Sets up the UART of a session and starts its command thread */
+static int uart_session_init(struct uart_session_t *session, int id) {
 
     /* Local vars */    
     int err = 0; /* Generic error variable */
 
+    session->id = id;
+    session->rx_start = 0;
+    k_mem_slab_init(&session->frame_slab, session->frame_pool, sizeof(struct uart_data_item_t), UART_FRAME_POOL_SIZE);
+    for(int i = 0; i < UART_N_LANES; i++) {
+        k_fifo_init(&session->lanes[i].fifo);
+        stats_reset(&session->lanes[i].latency_us);
+        stats_hist_reset(&session->lanes[i].latency_hist_us);
+    }
+    uart_cmd_latency_reset(session);
+    k_sem_init(&session->rx_items, 0, K_SEM_MAX_LIMIT);
+    ring_buf_init(&session->tx_ring, sizeof(session->tx_buf), session->tx_buf);
+    k_sem_init(&session->tx_space, 0, 1);
+
     /* Check if uart device is open */
-    if (!device_is_ready(uart_dev)) {
-        printk("device_is_ready(uart) returned error! Aborting! \n\r");
-        return FATAL_ERR;
+    if (!device_is_ready(session->dev)) {
+        LOG_ERR("%s: device_is_ready(uart) returned error!", session->name);
+        return -ENODEV;
     }
 
     /* Configure UART */
-    err = uart_configure(uart_dev, &uart_cfg);
+    err = uart_configure(session->dev, &uart_cfg);
     if (err == -ENOSYS) { /* If invalid configuration */
-        printk("uart_configure() error. Invalid configuration\n\r");
-        return FATAL_ERR; 
+        LOG_ERR("%s: uart_configure() error. Invalid configuration", session->name);
+        return err; 
     }
 
     /* Register callback */
-    err = uart_callback_set(uart_dev, uart_cb, NULL);
+    err = uart_callback_set(session->dev, uart_cb, session);
     if (err) {
-        printk("uart_callback_set() error. Error code:%d\n\r",err);
-        return FATAL_ERR;
+        LOG_ERR("%s: uart_callback_set() error. Error code:%d", session->name, err);
+        return err;
     }
 
     /* Enable data reception */
-    err =  uart_rx_enable(uart_dev ,rx_buf,sizeof(rx_buf),RX_TIMEOUT);
+    err =  uart_rx_enable(session->dev ,session->rx_buf,sizeof(session->rx_buf),RX_TIMEOUT);
     if (err) {
-        printk("uart_rx_enable() error. Error code:%d\n\r",err);
-        return FATAL_ERR;
+        LOG_ERR("%s: uart_rx_enable() error. Error code:%d", session->name, err);
+        return err;
     }
 
-    printf("You can start sending commands!\n\r");
+    /* Each session parses and executes its commands in its own thread */
+    session->tid = k_thread_create(&session->thread, uart_session_stacks[id],
+        K_THREAD_STACK_SIZEOF(uart_session_stacks[id]), fifo_thread_code,
+        session, NULL, NULL, UART_SESSION_PRIO, 0, K_NO_WAIT);
+    k_thread_name_set(session->tid, session->name);
+
+    uart_reply(session, "You can start sending commands!\n\r");
+
+    return 0;
+}
+
+uint16_t uart_init() {
+
+    for(int i = 0; i < ARRAY_SIZE(uart_sessions); i++) {
+        int err = uart_session_init(&uart_sessions[i], i);
+        if(err) {
+            /* The host link is required, other links are optional */
+            if(i == 0) {
+                LOG_ERR("Host UART not available! Aborting!");
+                return FATAL_ERR;
+            }
+            LOG_WRN("%s: session not started (%d)", uart_sessions[i].name, err);
+        }
+    }
 
     return 1;
 }
 
-uint16_t validate_command(char *command) {
-    
-    uint16_t ret = regcomp(&regex, command_pattern, REG_EXTENDED);
-    if(ret != 0) {
-        return REGEX_COMPILE_FAIL;
+int uart_session_count(void) {
+    return ARRAY_SIZE(uart_sessions);
+}
+
+const struct uart_session_t *uart_session_get(int idx) {
+    if(idx < 0 || idx >= ARRAY_SIZE(uart_sessions)) {
+        return NULL;
     }
+    return &uart_sessions[idx];
+}
+
+int uart_session_write(struct uart_session_t *session, const uint8_t *data, size_t len) {
+
+    while(len > 0) {
+        k_spinlock_key_t key = k_spin_lock(&session->tx_lock);
+        uint32_t n = ring_buf_put(&session->tx_ring, data, len);
+        uart_tx_start(session);
+        k_spin_unlock(&session->tx_lock, key);
+
+        data += n;
+        len -= n;
+
+        /* Queue full, wait for the driver to send part of it */
+        if(len > 0 && k_sem_take(&session->tx_space, K_MSEC(UART_TX_TIMEOUT_MS)) != 0) {
+            return -EAGAIN;
+        }
+    }
+    return 0;
+}
+
+int uart_reply(struct uart_session_t *session, const char *fmt, ...) {
+
+    char msg[MSG_BUF_SIZE];
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    if(len < 0) {
+        return len;
+    }
+    return uart_session_write(session, (uint8_t *)msg, MIN(len, sizeof(msg) - 1));
+}
+
+static bool command_class_match(char class, char c) {
+    switch(class) {
+        case 'd': return c >= '0' && c <= '9';
+        case 'f': return c >= '0' && c <= '4';
+        case 'q': return c >= '0' && c <= '3';
+        case 'b': return c == '0' || c == '1';
+        case 'u': return c >= 'A' && c <= 'Z';
+        case 't': return c != 0 && strchr("HLRFBC", c) != NULL;
+        case 'l': return c == 'L' || c == 'D';
+        case 'r': return c == 'R' || c == 'V';
+        case 's': return c == 'S' || c == 'C';
+        case 'a': return c != 0 && strchr("FISCT", c) != NULL;
+        case 'e': return c != 0 && strchr("PRLD", c) != NULL;
+        default: return c == class;
+    }
+}
+
+/* Matches the n argument characters against one form, of form_len characters */
+static bool command_form_match(const char *form, int form_len, const char *args, int n) {
+
+    /* Characters taken by a '+' class: whatever the fixed ones leave */
+    int plus = 0;
+    for(int i = 0; i < form_len; i++) {
+        plus += (form[i] == '+');
+    }
+    int repeat = n - (form_len - 2 * plus);
+    if(plus ? (repeat < 1 || repeat > COMMAND_MAX_REPEAT) : (n != form_len)) {
+        return false;
+    }
+
+    for(int i = 0; i < form_len; i++) {
+        bool repeated = (i + 1 < form_len && form[i + 1] == '+');
+        for(int j = 0; j < (repeated ? repeat : 1); j++) {
+            if(!command_class_match(form[i], *args++)) {
+                return false;
+            }
+        }
+        if(repeated) {
+            i++;    /* Skip the '+' */
+        }
+    }
+    return true;
+}
+
+uint16_t validate_command(char *command) {
 
-    ret = regexec(&regex, command, 0, NULL, 0);
-    if(ret == 0) {
-        return VALID_COMMAND;
-    } else if(ret == REG_NOMATCH) {
+    int len = strlen(command);
+
+    /* '#', opcode, checksum (000 to 255) and '!' */
+    if(len < 6 || command[0] != SOF_SYM || command[len - 1] != EOF_SYM) {
         return INVALID_COMMAND;
-    } 
-    return REGEX_MATCH_FAIL;
+    }
+    const char *checksum = &command[len - 4];
+    for(int i = 0; i < 3; i++) {
+        if(checksum[i] < '0' || checksum[i] > '9') {
+            return INVALID_COMMAND;
+        }
+    }
+    if(parse_digits((const uint8_t *)checksum, 3) > 255) {
+        return INVALID_COMMAND;
+    }
 
+    const char *args = &command[2];
+    int n_args = len - 6;
+
+    for(int i = 0; i < ARRAY_SIZE(command_forms); i++) {
+        if(command_forms[i].opcode != command[1]) {
+            continue;
+        }
+        const char *form = command_forms[i].forms;
+        while(1) {
+            const char *sep = strchr(form, '|');
+            int form_len = sep ? sep - form : strlen(form);
+            if(command_form_match(form, form_len, args, n_args)) {
+                return VALID_COMMAND;
+            }
+            if(!sep) {
+                return INVALID_COMMAND;
+            }
+            form = sep + 1;
+        }
+    }
+    return INVALID_COMMAND;
 }
 
 uint16_t validate_checksum(char *command, uint16_t rx_occupied_bytes) {
@@ -177,71 +471,657 @@ uint16_t validate_checksum(char *command, uint16_t rx_occupied_bytes) {
 
 }
 
+#if defined(CONFIG_APP_TRACE)
+/* Binary trace dump: a text header line per CPU followed by its records */
+static void uart_trace_dump(struct uart_session_t *session) {
+    char line[MSG_BUF_SIZE];
+    int len;
+
+    trace_read_begin();
+
+    len = snprintf(line, sizeof(line), "TRACE BEGIN CPUS: %d HZ: %u\n", CONFIG_MP_MAX_NUM_CPUS, (unsigned int)trace_hz());
+    uart_session_write(session, (uint8_t *)line, len);
+
+    for(int cpu = 0; cpu < CONFIG_MP_MAX_NUM_CPUS; cpu++) {
+        uint32_t lost;
+        int count = trace_count(cpu, &lost);
+        len = snprintf(line, sizeof(line), "TRACE CPU: %d RECORDS: %d LOST: %u\n", cpu, count, (unsigned int)lost);
+        uart_session_write(session, (uint8_t *)line, len);
+
+        for(int i = 0; i < count; i++) {
+            struct trace_rec_t rec;
+            trace_get(cpu, i, &rec);
+            uint8_t raw[8] = {
+                rec.timestamp, rec.timestamp >> 8, rec.timestamp >> 16, rec.timestamp >> 24,
+                rec.event, rec.ctx, rec.arg, rec.arg >> 8
+            };
+            uart_session_write(session, raw, sizeof(raw));
+        }
+    }
+
+    len = snprintf(line, sizeof(line), "TRACE END\n");
+    uart_session_write(session, (uint8_t *)line, len);
+
+    trace_read_end();
+}
+#endif
+
+#if defined(CONFIG_APP_CAPTURE)
+/* Binary capture block: a text header, the 10-bit samples packed 4 per 5 bytes (little endian), a CRC trailer */
+static void uart_capture_dump(struct uart_session_t *session) {
+    struct capture_info_t info;
+    char line[MSG_BUF_SIZE];
+    int len;
+
+    if(capture_read_begin(&info) != 0) {
+        uart_reply(session, "CAPTURE NOT READY\n");
+        return;
+    }
+
+    len = snprintf(line, sizeof(line), "CAPTURE BEGIN SAMPLES: %u TRIGGER: %u INTERVAL: %u us BYTES: %u\n",
+                   (unsigned int)info.samples, (unsigned int)info.trigger_idx, (unsigned int)info.interval_us,
+                   (unsigned int)((info.samples + 3) / 4 * 5));
+    uart_session_write(session, (uint8_t *)line, len);
+
+    uint16_t crc = 0xFFFF;
+    for(uint32_t i = 0; i < info.samples; i += 4) {
+        uint64_t bits = 0;
+        for(int j = 0; j < 4 && i + j < info.samples; j++) {
+            bits |= (uint64_t)(capture_get(i + j) & 0x3FF) << (10 * j);
+        }
+        uint8_t packed[5];
+        for(int j = 0; j < sizeof(packed); j++) {
+            packed[j] = bits >> (8 * j);
+        }
+        crc = crc16_itu_t(crc, packed, sizeof(packed));
+        uart_session_write(session, packed, sizeof(packed));
+    }
+
+    len = snprintf(line, sizeof(line), "CAPTURE END CRC: %04X\n", crc);
+    uart_session_write(session, (uint8_t *)line, len);
+
+    capture_read_end();
+}
+#endif
+
+uint16_t uart_command_len(const struct uart_data_item_t *item) {
+
+    if(item->rx_buf_end >= item->rx_buf_start) {
+        return (item->rx_buf_end - item->rx_buf_start + 1); 
+    }
+    /* The command wraps around the end of the RX buffer */
+    return (RXBUF_SIZE - item->rx_buf_start + item->rx_buf_end + 1); 
+}
+
+uint16_t uart_extract_command(const struct uart_data_item_t *item, uint8_t *command) {
+
+    uint16_t command_len = uart_command_len(item);
+
+    for(int i = 0; i < command_len; i++) {
+        command[i] = item->rx_chars[(item->rx_buf_start + i) % RXBUF_SIZE];
+    }
+
+    command[command_len] = 0; /* Terminate the string */
+
+    return command_len;
+}
+
+uint8_t uart_command_lane(const struct uart_data_item_t *item) {
+
+    uint16_t command_len = uart_command_len(item);
+    uint8_t opcode = item->rx_chars[(item->rx_buf_start + 1) % RXBUF_SIZE];
+
+    switch(opcode) {
+        case 'L':
+            /* '#Lx' + checksum reads, longer frames ('#Lxy', '#LM...') write */
+            return command_len > 7 ? UART_LANE_URGENT : UART_LANE_BULK;
+        case 'P':
+            return command_len > 7 ? UART_LANE_URGENT : UART_LANE_BULK;
+        case 'K':
+        case 'Q':
+            return UART_LANE_URGENT;
+        case 'C':
+            /* A command trigger must land close to the event it marks */
+            return item->rx_chars[(item->rx_buf_start + 2) % RXBUF_SIZE] == 'T' ? UART_LANE_URGENT : UART_LANE_BULK;
+        default:
+            return UART_LANE_BULK;
+    }
+}
+
+/* Takes the next frame of a session: urgent lane first, bulk lane after a burst of urgent ones */
+static struct uart_data_item_t *uart_lane_next(struct uart_session_t *session) {
+
+    struct uart_lane_t *urgent = &session->lanes[UART_LANE_URGENT];
+    struct uart_lane_t *bulk = &session->lanes[UART_LANE_BULK];
+    bool urgent_waiting = !k_fifo_is_empty(&urgent->fifo);
+    bool bulk_waiting = !k_fifo_is_empty(&bulk->fifo);
+    struct uart_lane_t *lane;
+
+    if(urgent_waiting && !(bulk_waiting && session->urgent_streak >= UART_URGENT_BURST)) {
+        lane = urgent;
+        session->urgent_streak = bulk_waiting ? session->urgent_streak + 1 : 0;
+    } else {
+        lane = bulk;
+        if(urgent_waiting) {
+            bulk->promoted++;
+        }
+        session->urgent_streak = 0;
+    }
+
+    struct uart_data_item_t *item = k_fifo_get(&lane->fifo, K_NO_WAIT);
+    if(item != NULL) {
+        atomic_dec(&lane->depth);
+        lane->served++;
+    }
+    return item;
+}
+
 void fifo_thread_code(void *argA , void *argB, void *argC) {
    
+   struct uart_session_t *session = argA;
    struct uart_data_item_t *rx_data;
 
     while(1) {
 
-        rx_data = k_fifo_get(&uart_fifo, K_FOREVER);
+        k_sem_take(&session->rx_items, K_FOREVER);
+        rx_data = uart_lane_next(session);
 
         if(rx_data != NULL) {
-
+            cycles_stamp_t dispatch_stamp = cycles_now();
+            TRACE(TRACE_EVT_CMD_DEQUEUE, rx_data->seq);
 
             /* Extract command from buffer */
-            uint16_t command_len;
+            uint8_t command[RXBUF_SIZE + 1];
+            uint16_t command_len = uart_extract_command(rx_data, command);
 
-            if(rx_data->rx_buf_end >= rx_data->rx_buf_start) {
-                command_len = (rx_data->rx_buf_end - rx_data->rx_buf_start + 1); 
-            } else {
-                command_len = (RXBUF_SIZE - rx_data->rx_buf_start + rx_data->rx_buf_end + 1); 
-            }
+            LOG_DBG("%s COMMAND: %s", session->name, command);
 
-            uint8_t *command = (uint8_t *)malloc(command_len + 1);
+            int command_valid = validate_command(command) == VALID_COMMAND && validate_checksum(command, command_len) == CHECKSUM_MATCH;
+            TRACE(TRACE_EVT_CMD_PARSED, rx_data->seq);
 
-            for(int i = 0; i < command_len; i++) {
-                command[i] = rx_data->rx_chars[(rx_data->rx_buf_start + i) % RXBUF_SIZE];
-            }
-
-            command[command_len] = 0; /* Terminate the string */
-
-            printf("COMMAND: %s\n", command);
-
-            if(validate_command(command) == VALID_COMMAND && validate_checksum(command, command_len) == CHECKSUM_MATCH) {
+            if(!command_valid) {
+                session->stats.invalid++;
+            } else {
+                session->stats.commands++;
                 switch(command[1]) {
                     case 'B':
                         int res;
                         rtdb_read_button(command[2]-'0', &res);
-                        printf("BUTTON %c STATUS: %d\n", command[2], res);
+                        uart_reply(session, "BUTTON %c STATUS: %d\n", command[2], res);
                         break;
                     case 'L':
-                        if(command_len == 7) {
+                        if(command[2] == 'A' || command[2] == 'M') {
+                            uint32_t leds;
+                            char status[N_LEDS + 1] = { 0 };
+                            if(command[2] == 'M') {
+                                /* Mask then values, LED 0 first, committed as one RTDB update */
+                                struct rtdb_leds_txn_t txn;
+                                rtdb_leds_txn_begin(&txn);
+                                for(int i = 0; i < N_LEDS; i++) {
+                                    if(command[3 + i] == '1') {
+                                        pwm_leds_release(i);
+                                        rtdb_leds_txn_stage(&txn, i, command[3 + N_LEDS + i] - '0');
+                                    }
+                                }
+                                rtdb_leds_txn_commit(&txn);
+                            }
+                            rtdb_read_leds(&leds);
+                            for(int i = 0; i < N_LEDS; i++) {
+                                status[i] = (leds & BIT(i)) ? '1' : '0';
+                            }
+                            uart_reply(session, "LEDS STATUS: %s\n", status);
+                        } else if(command_len == 7) {
                             int res;
                             rtdb_read_led(command[2]-'0', &res);
-                            printf("LED %c STATUS: %d\n", command[2], res);
+                            uart_reply(session, "LED %c STATUS: %d\n", command[2], res);
                         } else {
+                            /* A binary write takes the LED back from the PWM engine */
+                            pwm_leds_release(command[2]-'0');
                             rtdb_set_led(command[2]-'0', command[3]-'0');
-                            printf("LED %c STATUS CHANGED TO %c\n", command[2], command[3]);
+                            uart_reply(session, "LED %c STATUS CHANGED TO %c\n", command[2], command[3]);
                         }
                         break;
                     case 'A':
                         if(command[2] == 'R') {
                             int raw;
                             rtdb_read_adc_raw(&raw);
-                            printf("ADC RAW: %d\n", raw);
+                            uart_reply(session, "ADC RAW: %d\n", raw);
                         } else if(command[2] == 'V') {
                             int an;
                             rtdb_read_adc_an(&an);
-                            printf("ADC VAL: %d\n", an);
+                            uart_reply(session, "ADC VAL: %d\n", an);
+                        }
+                        break;
+                    case 'E':
+                        struct event_item_t ev;
+                        int n_events = 0;
+                        /* Drain the whole event log in one go */
+                        while(events_pop(&ev)) {
+                            if(ev.source == EVT_SRC_TASK) {
+                                uart_reply(session, "EVENT %u %c%c %s\n", (unsigned int)ev.timestamp, ev.source, ev.id, events_type_name(ev.type));
+                            } else {
+                                uart_reply(session, "EVENT %u %c%u %s\n", (unsigned int)ev.timestamp, ev.source, ev.id, events_type_name(ev.type));
+                            }
+                            n_events++;
+                        }
+                        uart_reply(session, "EVENTS: %d LOST: %u\n", n_events, (unsigned int)events_take_lost());
+                        break;
+                    case 'G':
+                        if(command_len > 6) {
+                            int ms = parse_digits(&command[3], 4);
+                            int err = (command[2] == 'L') ? gestures_set_long_press(ms) : gestures_set_double_click(ms);
+                            if(err) {
+                                uart_reply(session, "GESTURE TIME OUT OF RANGE (%d-%d ms)\n", GESTURE_TIME_MIN, GESTURE_TIME_MAX);
+                                break;
+                            }
                         }
+                        int long_press, double_click;
+                        gestures_get_timing(&long_press, &double_click);
+                        uart_reply(session, "GESTURE LONG: %d ms DOUBLE: %d ms\n", long_press, double_click);
+                        break;
+                    case 'P':
+                    case 'K':
+                    case 'Q':
+                        int led_id = command[2]-'0';
+                        int pwm_err = 0;
+                        if(command[1] == 'P' && command_len > 7) {
+                            pwm_err = pwm_leds_set_duty(led_id, parse_digits(&command[3], 3));
+                        } else if(command[1] == 'K') {
+                            pwm_err = pwm_leds_set_blink(led_id, parse_digits(&command[3], 4));
+                        } else if(command[1] == 'Q') {
+                            /* Pattern steps are given first to last, one char per step */
+                            int n_steps = command_len - 11;
+                            uint16_t pattern = 0;
+                            for(int i = 0; i < n_steps; i++) {
+                                if(command[3 + i] == '1') {
+                                    pattern |= BIT(i);
+                                }
+                            }
+                            pwm_err = pwm_leds_set_pattern(led_id, pattern, n_steps, parse_digits(&command[3 + n_steps], 4));
+                        }
+                        if(pwm_err) {
+                            uart_reply(session, "PWM LED %c: INVALID PARAMETERS\n", command[2]);
+                            break;
+                        }
+                        struct pwm_led_cfg_t cfg;
+                        pwm_leds_get(led_id, &cfg);
+                        uart_reply(session, "PWM LED %c MODE: %s (%s) DUTY: %d%% PATTERN: ", command[2],
+                               cfg.mode == PWM_LED_MODE_GPIO ? "GPIO" : (cfg.mode == PWM_LED_MODE_STEADY ? "STEADY" : "PATTERN"),
+                               cfg.hw ? "HW" : "SOFT", cfg.duty);
+                        for(int i = 0; i < cfg.pattern_len; i++) {
+                            uart_reply(session, "%c", (cfg.pattern & BIT(i)) ? '1' : '0');
+                        }
+                        uart_reply(session, " STEP: %d ms\n", cfg.step_ms);
+                        break;
+                    case 'J':
+                        /* Release jitter of every periodic task */
+                        struct exec_task_t task;
+                        for(int i = 0; i < exec_task_count(); i++) {
+                            exec_task_get(i, &task);
+                            struct stat_acc_t *jit = &task.stats.jitter_us;
+                            uart_reply(session, "TASK %c(%s) PERIOD: %u ms JOBS: %u JITTER MIN: %u us MEAN: %u us MAX: %u us\n",
+                                   task.id, task.name, (unsigned int)task.period_ms, (unsigned int)task.stats.activations,
+                                   jit->count ? (unsigned int)jit->min : 0, (unsigned int)stats_mean(jit), (unsigned int)jit->max);
+                        }
+                        break;
+                    case 'S':
+                        int stats_idx = exec_task_find(command[2]);
+                        if(stats_idx < 0) {
+                            uart_reply(session, "TASK %c NOT FOUND\n", command[2]);
+                            break;
+                        }
+                        struct exec_stats_t st;
+                        exec_stats_get(stats_idx, &st);
+                        uart_reply(session, "STATS %c JOBS: %u\n", command[2], (unsigned int)st.activations);
+                        uart_reply(session, "EXEC ns MIN: %u MEAN: %u MAX: %u\n", st.exec_ns.count ? (unsigned int)st.exec_ns.min : 0,
+                               (unsigned int)stats_mean(&st.exec_ns), (unsigned int)st.exec_ns.max);
+                        uart_reply(session, "JITTER us MIN: %u MEAN: %u MAX: %u\n", st.jitter_us.count ? (unsigned int)st.jitter_us.min : 0,
+                               (unsigned int)stats_mean(&st.jitter_us), (unsigned int)st.jitter_us.max);
+                        uart_reply(session, "RESPONSE us MIN: %u MEAN: %u MAX: %u\n", st.response_us.count ? (unsigned int)st.response_us.min : 0,
+                               (unsigned int)stats_mean(&st.response_us), (unsigned int)st.response_us.max);
+                        uart_reply(session, "DEADLINE MISSES: %u LAST MISS: %u ms SKIPPED: %u\n", (unsigned int)st.deadline_misses,
+                               (unsigned int)st.last_miss_ms, (unsigned int)st.skipped);
+                        /* Execution time histogram, one "lower bound:count" pair per bucket */
+                        uart_reply(session, "EXEC HIST us");
+                        for(int i = 0; i < STATS_HIST_BUCKETS; i++) {
+                            uart_reply(session, " %u:%u", (unsigned int)stats_hist_bucket_min(i), (unsigned int)st.exec_hist_us.bucket[i]);
+                        }
+                        uart_reply(session, "\n");
+                        if(command_len > 7) {
+                            exec_stats_reset(stats_idx);
+                            uart_reply(session, "STATS %c RESET\n", command[2]);
+                        }
+                        break;
+                    case 'T':
+                        int task_idx = exec_task_find(command[2]);
+                        if(task_idx < 0) {
+                            uart_reply(session, "TASK %c NOT FOUND\n", command[2]);
+                            break;
+                        }
+                        if(command_len > 7 && exec_set_period(task_idx, parse_digits(&command[3], 5))) {
+                            uart_reply(session, "PERIOD OUT OF RANGE (%d-%d ms)\n", EXEC_PERIOD_MIN_MS, EXEC_PERIOD_MAX_MS);
+                            break;
+                        }
+                        exec_task_get(task_idx, &task);
+                        uart_reply(session, "TASK %c(%s) PERIOD: %u ms\n", task.id, task.name, (unsigned int)task.period_ms);
+                        break;
+                    case 'D':
+                        int dl_idx = exec_task_find(command[2]);
+                        if(dl_idx < 0) {
+                            uart_reply(session, "TASK %c NOT FOUND\n", command[2]);
+                            break;
+                        }
+                        if(command_len > 7) {
+                            uint8_t policy = (command[8] == 'C') ? EXEC_POLICY_CATCHUP : EXEC_POLICY_SKIP;
+                            if(exec_set_deadline(dl_idx, parse_digits(&command[3], 5), policy)) {
+                                uart_reply(session, "DEADLINE OUT OF RANGE (0-%d ms)\n", EXEC_PERIOD_MAX_MS);
+                                break;
+                            }
+                        }
+                        exec_task_get(dl_idx, &task);
+                        uart_reply(session, "DEADLINE %c: %u ms POLICY: %s MISSES: %u LAST MISS: %u ms SKIPPED: %u\n", task.id,
+                               (unsigned int)(task.deadline_ms ? task.deadline_ms : task.period_ms),
+                               task.policy == EXEC_POLICY_CATCHUP ? "CATCHUP" : "SKIP",
+                               (unsigned int)task.stats.deadline_misses, (unsigned int)task.stats.last_miss_ms,
+                               (unsigned int)task.stats.skipped);
+                        break;
+                    case 'M':
+                        /* Stack high-water marks */
+                        struct memtel_thread_t threads[MEMTEL_MAX_THREADS];
+                        int n_threads = memtel_threads(threads, MEMTEL_MAX_THREADS);
+                        for(int i = 0; i < n_threads; i++) {
+                            uart_reply(session, "MEM STACK %s SIZE: %u USED: %u FREE: %u\n", threads[i].name, (unsigned int)threads[i].size,
+                                   (unsigned int)(threads[i].size - threads[i].unused), (unsigned int)threads[i].unused);
+                        }
+                        /* Heaps */
+                        struct memtel_heap_t heap;
+                        if(memtel_kernel_heap(&heap) == 0) {
+                            uart_reply(session, "MEM HEAP SIZE: %u USED: %u MAX USED: %u\n",
+                                   (unsigned int)heap.size, (unsigned int)heap.used, (unsigned int)heap.max_used);
+                        }
+                        if(memtel_libc_heap(&heap) == 0) {
+                            uart_reply(session, "MEM LIBC HEAP SIZE: %u USED: %u\n", (unsigned int)heap.size, (unsigned int)heap.used);
+                        }
+                        /* Pool/queue watermarks */
+                        for(int i = 0; i < uart_session_count(); i++) {
+                            uart_reply(session, "MEM POOL UART_FIFO %s HWM: URGENT %u BULK %u\n", uart_sessions[i].name,
+                                       (unsigned int)atomic_get(&uart_sessions[i].lanes[UART_LANE_URGENT].high_water),
+                                       (unsigned int)atomic_get(&uart_sessions[i].lanes[UART_LANE_BULK].high_water));
+                            uart_reply(session, "MEM POOL UART_FRAMES %s USED: %u/%u\n", uart_sessions[i].name,
+                                       (unsigned int)k_mem_slab_num_used_get(&uart_sessions[i].frame_slab), UART_FRAME_POOL_SIZE);
+                        }
+                        uart_reply(session, "MEM POOL EVENTS HWM: %u/%u\n", (unsigned int)events_high_water(), EVENT_RING_SIZE);
+                        break;
+                    case 'O':
+                        if(command_len > 6) {
+                            opmode_set(command[2] == '1' ? OPMODE_EVENT : OPMODE_PERIODIC);
+                        }
+                        uart_reply(session, "MODE: %s WAKEUPS UART: %u GPIO: %u ADC: %u TIMER: %u\n",
+                               opmode_get() == OPMODE_EVENT ? "EVENT" : "PERIODIC",
+                               (unsigned int)opmode_wakeups(WAKE_SRC_UART), (unsigned int)opmode_wakeups(WAKE_SRC_GPIO),
+                               (unsigned int)opmode_wakeups(WAKE_SRC_ADC), (unsigned int)opmode_wakeups(WAKE_SRC_TIMER));
+                        break;
+                    case 'R':
+#if defined(CONFIG_APP_TRACE)
+                        if(command_len > 6) {
+                            trace_enable(command[2] == '1');
+                            uart_reply(session, "TRACE %s\n", trace_enabled() ? "ON" : "OFF");
+                            break;
+                        }
+                        uart_trace_dump(session);
+#else
+                        uart_reply(session, "TRACE NOT ENABLED (CONFIG_APP_TRACE)\n");
+#endif
+                        break;
+                    case 'I':
+                        /* Per-session link statistics */
+                        for(int i = 0; i < uart_session_count(); i++) {
+                            const struct uart_session_t *ses = &uart_sessions[i];
+                            uart_reply(session, "SESSION %d %s RX: %u FRAMES: %u DROPPED: %u INVALID: %u COMMANDS: %u TX: %u\n",
+                                       ses->id, ses->name, (unsigned int)ses->stats.rx_bytes, (unsigned int)ses->stats.frames,
+                                       (unsigned int)ses->stats.rx_dropped, (unsigned int)ses->stats.invalid,
+                                       (unsigned int)ses->stats.commands, (unsigned int)ses->stats.tx_bytes);
+                            /* Per-lane queue and latency, one "lower bound:count" pair per histogram bucket */
+                            for(int l = 0; l < UART_N_LANES; l++) {
+                                const struct uart_lane_t *lane = &ses->lanes[l];
+                                uart_reply(session, "LANE %s SERVED: %u PROMOTED: %u HWM: %u LATENCY us MIN: %u MEAN: %u MAX: %u\n",
+                                           l == UART_LANE_URGENT ? "URGENT" : "BULK", (unsigned int)lane->served,
+                                           (unsigned int)lane->promoted, (unsigned int)atomic_get(&lane->high_water),
+                                           lane->latency_us.count ? (unsigned int)lane->latency_us.min : 0,
+                                           (unsigned int)stats_mean(&lane->latency_us), (unsigned int)lane->latency_us.max);
+                                uart_reply(session, "LANE %s HIST us", l == UART_LANE_URGENT ? "URGENT" : "BULK");
+                                for(int b = 0; b < STATS_HIST_BUCKETS; b++) {
+                                    uart_reply(session, " %u:%u", (unsigned int)stats_hist_bucket_min(b), (unsigned int)lane->latency_hist_us.bucket[b]);
+                                }
+                                uart_reply(session, "\n");
+                            }
+                        }
+                        break;
+                    case 'H':
+                        /* Command latencies of this session, classes without samples are skipped */
+                        for(int c = 0; c < UART_N_CMD_CLASSES; c++) {
+                            const struct uart_cmd_latency_t *lat = &session->cmd_latency[c];
+                            if(lat->service_us.count == 0) {
+                                continue;
+                            }
+                            /* One line each, both together do not fit in a reply buffer */
+                            uart_reply(session, "CMD %s COUNT: %u WAIT us MIN: %u MEAN: %u MAX: %u\n",
+                                       uart_cmd_class_names[c], (unsigned int)lat->service_us.count,
+                                       (unsigned int)lat->wait_us.min, (unsigned int)stats_mean(&lat->wait_us),
+                                       (unsigned int)lat->wait_us.max);
+                            uart_reply(session, "CMD %s SERVICE us MIN: %u MEAN: %u MAX: %u\n",
+                                       uart_cmd_class_names[c], (unsigned int)lat->service_us.min,
+                                       (unsigned int)stats_mean(&lat->service_us), (unsigned int)lat->service_us.max);
+                            uart_reply(session, "CMD %s WAIT HIST us", uart_cmd_class_names[c]);
+                            for(int b = 0; b < STATS_HIST_BUCKETS; b++) {
+                                uart_reply(session, " %u:%u", (unsigned int)stats_hist_bucket_min(b), (unsigned int)lat->wait_hist_us.bucket[b]);
+                            }
+                            uart_reply(session, "\nCMD %s SERVICE HIST us", uart_cmd_class_names[c]);
+                            for(int b = 0; b < STATS_HIST_BUCKETS; b++) {
+                                uart_reply(session, " %u:%u", (unsigned int)stats_hist_bucket_min(b), (unsigned int)lat->service_hist_us.bucket[b]);
+                            }
+                            uart_reply(session, "\n");
+                        }
+                        if(command_len > 6) {
+                            uart_cmd_latency_reset(session);
+                            uart_reply(session, "CMD LATENCY RESET\n");
+                        }
+                        break;
+                    case 'V':
+                        if(command_len > 6) {
+                            int applied = logctl_set(command[2]-'0', command[3]-'0');
+                            if(applied < 0) {
+                                uart_reply(session, "LOG LEVEL NOT SET (%d)\n", applied);
+                                break;
+                            }
+                        }
+                        for(int i = 0; i < logctl_count(); i++) {
+                            uart_reply(session, "LOG %d %s: %s\n", i, logctl_name(i), logctl_level_name(logctl_get(i)));
+                        }
+                        break;
+                    case 'Z':
+#if defined(CONFIG_APP_SELFTEST)
+                        int selftest_failed = 0;
+                        struct selftest_check_t checks[SELFTEST_MAX_CHECKS];
+                        int n_checks = selftest_checks(checks, SELFTEST_MAX_CHECKS);
+                        for(int i = 0; i < n_checks; i++) {
+                            if(checks[i].failures) {
+                                uart_reply(session, "SELFTEST CHECK %s: FAIL %d/%d LAST: %s\n", checks[i].name,
+                                       checks[i].failures, checks[i].total, checks[i].detail);
+                                selftest_failed = 1;
+                            } else {
+                                uart_reply(session, "SELFTEST CHECK %s: PASS %d\n", checks[i].name, checks[i].total);
+                            }
+                        }
+                        /* Mean cycles per operation against the stored baseline */
+                        struct selftest_bench_t bench[SELFTEST_MAX_BENCH];
+                        int n_bench = selftest_bench(bench, SELFTEST_MAX_BENCH);
+                        for(int i = 0; i < n_bench; i++) {
+                            uart_reply(session, "SELFTEST BENCH %s: %u CYCLES %u ns BASELINE: %u %s\n", bench[i].name,
+                                   (unsigned int)bench[i].cycles, (unsigned int)bench[i].ns,
+                                   (unsigned int)bench[i].baseline_cycles,
+                                   bench[i].baseline_cycles ? (bench[i].regressed ? "REGRESSED" : "OK") : "NO BASELINE");
+                            selftest_failed |= bench[i].regressed;
+                        }
+                        uart_reply(session, "SELFTEST: %s\n", selftest_failed ? "FAIL" : "PASS");
+#else
+                        uart_reply(session, "SELFTEST NOT ENABLED (CONFIG_APP_SELFTEST)\n");
+#endif
+                        break;
+                    case 'C':
+#if defined(CONFIG_APP_CAPTURE)
+                        if(command_len > 6 && command[2] == 'D') {
+                            uart_capture_dump(session);
+                            break;
+                        }
+                        int capture_err = 0;
+                        if(command[2] == 'A') {
+                            capture_err = capture_arm(command[3], parse_digits(&command[4], 4));
+                        } else if(command[2] == 'T') {
+                            capture_err = capture_force();
+                        } else if(command[2] == 'S') {
+                            capture_err = capture_stop();
+                        }
+                        /* Then the state, also the reply to a bare '#C' */
+                        if(capture_err == -EINVAL) {
+                            uart_reply(session, "CAPTURE INVALID TRIGGER\n");
+                        } else if(capture_err == -EBUSY) {
+                            uart_reply(session, "CAPTURE BUSY\n");
+                        } else if(capture_err == -EAGAIN) {
+                            uart_reply(session, "CAPTURE NOT ARMED\n");
+                        } else if(capture_err) {
+                            uart_reply(session, "CAPTURE ERROR %d\n", capture_err);
+                        } else {
+                            struct capture_info_t cap;
+                            capture_info_get(&cap);
+                            uart_reply(session, "CAPTURE STATE: %s TRIGGER: %c LEVEL: %u SAMPLES: %u/%u PRE: %u INTERVAL: %u us\n",
+                                   capture_state_name(cap.state), cap.trigger, (unsigned int)cap.level,
+                                   (unsigned int)cap.samples, CONFIG_APP_CAPTURE_SAMPLES,
+                                   (unsigned int)(cap.state == CAPTURE_ARMED ? cap.samples : cap.trigger_idx),
+                                   (unsigned int)cap.interval_us);
+                        }
+#else
+                        uart_reply(session, "CAPTURE NOT ENABLED (CONFIG_APP_CAPTURE)\n");
+#endif
+                        break;
+                    case 'Y':
+#if defined(CONFIG_APP_REPLAY)
+                        if(command_len > 6 && command[2] == 'D') {
+                            /* Recording, in the trace text format */
+                            struct replay_info_t rep;
+                            struct replay_rec_t rec;
+                            char rec_line[REPLAY_LINE_SIZE];
+                            replay_info_get(&rep);
+                            uart_reply(session, "REPLAY TRACE BEGIN RECORDS: %u\n", (unsigned int)rep.recorded);
+                            for(uint32_t i = 0; replay_recorded_get(i, &rec) == 0; i++) {
+                                uart_session_write(session, (uint8_t *)rec_line, replay_format(&rec, rec_line));
+                            }
+                            uart_reply(session, "REPLAY TRACE END LOST: %u\n", (unsigned int)rep.lost);
+                            break;
+                        }
+                        if(command[2] == 'P' && replay_start() != 0) {
+                            uart_reply(session, "REPLAY NO TRACE\n");
+                            break;
+                        } else if(command[2] == 'S') {
+                            replay_stop();
+                        } else if(command[2] == 'R') {
+                            replay_record_start();
+                        } else if(command[2] == 'E') {
+                            replay_record_stop();
+                        }
+                        struct replay_info_t rep;
+                        replay_info_get(&rep);
+                        uart_reply(session, "REPLAY: %s SOURCE: %s POS: %u/%u RECORD: %s RECORDS: %u LOST: %u\n",
+                               rep.playing ? "PLAYING" : "STOPPED", rep.source, (unsigned int)rep.played,
+                               (unsigned int)rep.total, rep.recording ? "ON" : "OFF",
+                               (unsigned int)rep.recorded, (unsigned int)rep.lost);
+#else
+                        uart_reply(session, "REPLAY NOT ENABLED (CONFIG_APP_REPLAY)\n");
+#endif
+                        break;
+                    case 'U':
+#if defined(CONFIG_APP_RULES)
+                        if(command_len == 6) {
+                            struct rule_t rule;
+                            char rule_text[RULE_TEXT_SIZE];
+                            for(int i = 0; i < CONFIG_APP_RULES_MAX; i++) {
+                                if(rules_get(i, &rule) == 0) {
+                                    rules_format(&rule, rule_text);
+                                    uart_reply(session, "RULE %02d: %s FIRED: %u\n", i, rule_text, (unsigned int)rule.fired);
+                                }
+                            }
+                            uart_reply(session, "RULES: %d SLOTS\n", CONFIG_APP_RULES_MAX);
+                        } else if(command[2] == 'C') {
+                            rules_clear_all();
+                            uart_reply(session, "RULES CLEARED\n");
+                        } else {
+                            int slot = parse_digits(&command[2], 2);
+                            int rule_len = command_len - 8;
+                            int rule_err = rule_len ? rules_set(slot, (const char *)&command[4], rule_len) : rules_clear(slot);
+                            if(rule_err) {
+                                uart_reply(session, "RULE %02d INVALID\n", slot);
+                            } else if(rule_len) {
+                                uart_reply(session, "RULE %02d SET: %.*s\n", slot, rule_len, &command[4]);
+                            } else {
+                                uart_reply(session, "RULE %02d CLEARED\n", slot);
+                            }
+                        }
+#else
+                        uart_reply(session, "RULES NOT ENABLED (CONFIG_APP_RULES)\n");
+#endif
+                        break;
+                    case 'W':
+#if defined(CONFIG_APP_PERSIST)
+                        int persist_err = 0;
+                        if(command[2] == 'S') {
+                            persist_err = persist_flush();
+                        } else if(command[2] == 'E') {
+                            persist_err = persist_erase();
+                        }
+                        struct persist_info_t pinfo;
+                        char pending[64] = "";
+                        persist_info_get(&pinfo);
+                        for(int g = 0, len = 0; g < PERSIST_N_GROUPS; g++) {
+                            if(pinfo.dirty & BIT(g)) {
+                                len += snprintf(&pending[len], sizeof(pending) - len, " %s", persist_group_name(g));
+                            }
+                        }
+                        /* Three lines, each fits in a reply buffer with any counter value */
+                        uart_reply(session, "PERSIST: %s RESTORED: %u WRITES: %u UNCHANGED: %u ERRORS: %u\n",
+                               persist_err ? "ERROR" : "OK", (unsigned int)pinfo.restored, (unsigned int)pinfo.writes,
+                               (unsigned int)pinfo.unchanged, (unsigned int)pinfo.errors);
+                        uart_reply(session, "PERSIST LAST BATCH: %d ms AGO\n",
+                               pinfo.last_batch_ms < 0 ? -1 : (int)(k_uptime_get() - pinfo.last_batch_ms));
+                        uart_reply(session, "PERSIST PENDING:%s\n", pending[0] ? pending : " NONE");
+#else
+                        uart_reply(session, "PERSIST NOT ENABLED (CONFIG_APP_PERSIST)\n");
+#endif
                         break;
                     default:
-                        printf("INVALID COMMAND!\n");
+                        uart_reply(session, "INVALID COMMAND!\n");
                         break;
                 }
             }
 
-            k_free(rx_data); 
+            TRACE(TRACE_EVT_CMD_DONE, rx_data->seq);
+
+            /* Lane latency, from the end of frame to the reply. The reply is
+               queued, not sent yet: its transmission is not included */
+            cycles_stamp_t done_stamp = cycles_now();
+            uint32_t latency_us = (uint32_t)(cycles_to_ns(rx_data->rx_stamp, done_stamp) / 1000);
+            stats_add(&session->lanes[rx_data->lane].latency_us, latency_us);
+            stats_hist_add(&session->lanes[rx_data->lane].latency_hist_us, latency_us);
+
+            /* Command latency, split at the dispatch */
+            struct uart_cmd_latency_t *cmd_lat = &session->cmd_latency[uart_cmd_class(command, command_len, command_valid)];
+            uint32_t wait_us = (uint32_t)(cycles_to_ns(rx_data->rx_stamp, dispatch_stamp) / 1000);
+            uint32_t service_us = (uint32_t)(cycles_to_ns(dispatch_stamp, done_stamp) / 1000);
+            stats_add(&cmd_lat->wait_us, wait_us);
+            stats_hist_add(&cmd_lat->wait_hist_us, wait_us);
+            stats_add(&cmd_lat->service_us, service_us);
+            stats_hist_add(&cmd_lat->service_hist_us, service_us);
+
+            k_mem_slab_free(&session->frame_slab, rx_data);
         }
 
     }
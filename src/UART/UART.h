@@ -5,6 +5,22 @@
  * This file contains the declarations and configurations for UART communication.
  * It includes functions for configurating/initializing the UART, sending commands received to
  * the FIFO and processing those commands.
+ *
+ * Every UART carrying the protocol is served by a session: its own RX buffer
+ * and frame decoder state, command FIFO and thread, TX queue and statistics.
+ * The host link (uart0) is always present, a local HMI can be attached at the
+ * same time to the UART with the 'hmi-uart' devicetree alias. Sessions only
+ * share the RTDB, whose signals are locked individually.
+ *
+ * Within a session, frames are queued in one of two lanes: LED actuation
+ * commands go to the urgent lane, everything else (reads, reports, dumps,
+ * configuration) to the bulk lane. The command thread always serves the
+ * urgent lane first, except that after UART_URGENT_BURST urgent commands in
+ * a row one waiting bulk command is served, so reads cannot starve.
+ *
+ * The command path does not use the heap: received frames are taken from a
+ * fixed pool of each session (CONFIG_APP_UART_FRAME_POOL_SIZE), commands are
+ * validated without regex and every buffer is sized from Kconfig.
  * 
  * @author Diogo Lapa 117296
  * @author Bruno Duarte 118326
@@ -22,11 +38,16 @@
 #include <zephyr/devicetree.h>	    /* for DT_NODELABEL() */
 #include <zephyr/drivers/uart.h>    /* for UART API*/
 #include <zephyr/sys/printk.h>      /* for printk()*/
+#include <zephyr/logging/log.h>     /* for diagnostics, kept off the protocol UART */
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/timing/timing.h>   /* for timing services */
+#include <zephyr/sys/ring_buffer.h> /* for the TX queues */
+#include <zephyr/sys/crc.h>         /* for the capture block CRC */
+#include "../sched/stats.h"
+#include "../sched/cycles.h"
+#include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <regex.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -35,20 +56,39 @@
 #define VALID_COMMAND 0
 #define CHECKSUM_MATCH 0
 #define INVALID_COMMAND 1
-#define REGEX_COMPILE_FAIL 2
-#define REGEX_MATCH_FAIL 3
 #define CHECKSUM_MISMATCH 4
 
 #define UART_NODE DT_NODELABEL(uart0)   /* UART0 node ID*/
+#define UART_HMI_NODE DT_ALIAS(hmi_uart) /* Optional second UART, for a local HMI */
 #define MAIN_SLEEP_TIME_MS 1000 /* Time between main() activations */ 
 
 #define FATAL_ERR -1 /* Fatal error return code, app terminates */
 
-#define RXBUF_SIZE 60                   /* RX buffer size */
+#define RXBUF_SIZE CONFIG_APP_UART_RX_BUF_SIZE       /* RX buffer size */
 #define TXBUF_SIZE 60                   /* TX buffer size */
-#define MSG_BUF_SIZE 100                /* Buffer for messages sent vai UART */
+#define MSG_BUF_SIZE CONFIG_APP_UART_MSG_BUF_SIZE    /* Buffer for messages sent vai UART */
 #define RX_TIMEOUT 1000                 /* Inactivity period after the instant when last char was received that triggers an rx event (in us) */
 
+#define UART_MAX_SESSIONS 2             /* Max UARTs carrying the protocol */
+#define UART_SESSION_STACK_SIZE 1536    /* Stack of the command thread of a session */
+#define UART_SESSION_PRIO 1             /* Priority of the command threads */
+#define UART_TX_QUEUE_SIZE CONFIG_APP_UART_TX_QUEUE_SIZE    /* TX queue of a session (bytes) */
+#define UART_FRAME_POOL_SIZE CONFIG_APP_UART_FRAME_POOL_SIZE    /* Frames queued per session */
+#define UART_TX_TIMEOUT_MS 1000         /* Max wait for room in a full TX queue */
+
+#define UART_LANE_URGENT 0              /* LED actuation commands */
+#define UART_LANE_BULK 1                /* Reads, reports, dumps and configuration */
+#define UART_N_LANES 2
+#define UART_URGENT_BURST 4             /* Urgent commands served in a row while bulk ones wait */
+
+#define UART_CMD_BUTTON 0               /* 'B' */
+#define UART_CMD_LED_READ 1             /* 'Lq', 'LA' */
+#define UART_CMD_LED_WRITE 2            /* 'Lqb', 'LM' */
+#define UART_CMD_ADC_RAW 3              /* 'AR' */
+#define UART_CMD_ADC_VOLTS 4            /* 'AV' */
+#define UART_CMD_OTHER 5                /* Every other command, invalid frames included */
+#define UART_N_CMD_CLASSES 6
+
 /**
  * @struct uart_data_item_t
  * 
@@ -64,6 +104,101 @@ struct uart_data_item_t {
     uint8_t rx_chars[RXBUF_SIZE]; 
     int rx_buf_start;
     int rx_buf_end;
+    uint16_t seq;       /* Frame sequence number, identifies the frame in the trace */
+    uint8_t lane;       /* UART_LANE_URGENT or UART_LANE_BULK */
+    cycles_stamp_t rx_stamp;    /* End of frame reception, for the lane and command latencies */
+};
+
+/**
+ * @struct uart_session_stats_t
+ *
+ * @brief Link statistics of a session.
+ *
+ * Each counter has a single writer (the UART callback or the command thread
+ * of the session), readers may see a slightly stale value.
+ */
+struct uart_session_stats_t {
+    uint32_t rx_bytes;      /* Bytes received */
+    uint32_t frames;        /* Frames queued for processing */
+    uint32_t rx_dropped;    /* Frames lost, no memory for the FIFO item */
+    uint32_t invalid;       /* Frames rejected (format or checksum) */
+    uint32_t commands;      /* Commands executed */
+    uint32_t tx_bytes;      /* Bytes sent */
+};
+
+/**
+ * @struct uart_lane_t
+ *
+ * @brief Command lane of a session: queue and latency statistics.
+ *
+ * The latency of a command is measured from the reception of its end of
+ * frame to the end of its execution (reply queued).
+ */
+struct uart_lane_t {
+    struct k_fifo fifo;                 /* Frames waiting for the command thread */
+    atomic_t depth;                     /* Items currently queued */
+    atomic_t high_water;                /* Max items queued at the same time */
+    uint32_t served;                    /* Commands taken from the lane */
+    uint32_t promoted;                  /* Bulk commands served while urgent ones waited */
+    struct stat_acc_t latency_us;
+    struct stat_hist_t latency_hist_us;
+};
+
+/**
+ * @struct uart_cmd_latency_t
+ *
+ * @brief Service time of a command class, as seen by the firmware.
+ *
+ * The wait runs from the reception of the end of frame (UART callback) to
+ * the command thread taking the frame, the service from there to the reply
+ * being queued in the TX ring. The service ends when the reply is queued,
+ * not when it is transmitted: the UART_TX_DONE of a block can cover several
+ * replies and the callback does not know which command a byte belongs to,
+ * so the transmission (reply length over the baud rate, plus any wait for
+ * the replies queued before it) is not included. Only the command thread of
+ * the session writes them.
+ */
+struct uart_cmd_latency_t {
+    struct stat_acc_t wait_us;
+    struct stat_acc_t service_us;
+    struct stat_hist_t wait_hist_us;
+    struct stat_hist_t service_hist_us;
+};
+
+/**
+ * @struct uart_session_t
+ *
+ * @brief Protocol session bound to a UART device.
+ */
+struct uart_session_t {
+    const char *name;
+    const struct device *dev;
+    int id;                             /* Index, also tags the frames in the trace */
+
+    /* Reception and frame decoder */
+    uint8_t rx_buf[RXBUF_SIZE];
+    int rx_start;                       /* Index of the last start of frame */
+    uint16_t rx_seq;                    /* Sequence number of the next frame */
+    struct k_mem_slab frame_slab;       /* Received frames, from frame_pool */
+    struct uart_data_item_t frame_pool[UART_FRAME_POOL_SIZE];
+    struct uart_lane_t lanes[UART_N_LANES];
+    struct k_sem rx_items;              /* Frames queued in all lanes */
+    int urgent_streak;                  /* Urgent commands served in a row while bulk ones waited */
+    struct uart_cmd_latency_t cmd_latency[UART_N_CMD_CLASSES];
+
+    /* Transmission */
+    struct ring_buf tx_ring;
+    uint8_t tx_buf[UART_TX_QUEUE_SIZE];
+    struct k_spinlock tx_lock;
+    bool tx_busy;                       /* A block was handed to uart_tx() */
+    uint32_t tx_len;                    /* Size of that block */
+    struct k_sem tx_space;              /* Given when the driver frees queue space */
+
+    struct uart_session_stats_t stats;
+
+    /* Command thread */
+    struct k_thread thread;
+    k_tid_t tid;
 };
 
 /**
@@ -76,38 +211,84 @@ struct uart_data_item_t {
  *
  * @param dev Pointer to the UART device structure.
  * @param evt Pointer to the UART event structure containing event type and data.
- * @param user_data Pointer to user data, if any.
+ * @param user_data Session bound to the device.
  *
- * @warning This function may call `k_malloc` and `k_fifo_put`, ensure the necessary resources are available.
+ * @note Frames arriving when the frame pool of the session is exhausted are
+ * dropped (counted in rx_dropped).
  */
 void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data);
 
 /**
  * @brief Initialize the UART device.
  *
- * This function initializes the UART device by configuring it, setting up
- * the callback function for handling UART events, and enabling data reception.
+ * This function initializes the UART device of every session by configuring
+ * it, setting up the callback function for handling UART events and enabling
+ * data reception, then starts the command thread of the session.
  *
  * @return uint16_t 
  * - Returns 1 on successful initialization.
- * - Returns FATAL_ERR if an error occurs during initialization.
+ * - Returns FATAL_ERR if the host UART could not be initialized (a failing
+ *   HMI UART only disables its session).
  *
  */
 uint16_t uart_init();
 
+/**
+ * @brief Number of UART sessions.
+ *
+ * @return int Number of sessions.
+ */
+int uart_session_count(void);
+
+/**
+ * @brief Get a UART session.
+ *
+ * @param idx Session index.
+ *
+ * @return const struct uart_session_t* The session, NULL if the index is not valid.
+ */
+const struct uart_session_t *uart_session_get(int idx);
+
+/**
+ * @brief Queue bytes for transmission on a session.
+ *
+ * Blocks while the TX queue is full. Must not be called from an ISR.
+ *
+ * @param session Session.
+ * @param data Bytes to send (text or binary, sent unchanged).
+ * @param len Number of bytes.
+ *
+ * @return int
+ * - Returns 0 when all the bytes were queued.
+ * - Returns -EAGAIN if the queue stayed full for UART_TX_TIMEOUT_MS.
+ */
+int uart_session_write(struct uart_session_t *session, const uint8_t *data, size_t len);
+
+/**
+ * @brief Send a formatted response on a session.
+ *
+ * printf()-like, the response is truncated to MSG_BUF_SIZE - 1 chars.
+ *
+ * @param session Session.
+ * @param fmt Format string.
+ *
+ * @return int 0 on success, a negative error code otherwise (see uart_session_write()).
+ */
+int uart_reply(struct uart_session_t *session, const char *fmt, ...);
+
 /**
  * @brief Validate Command
  *
  * Validates whether the given command is valid or not.
- * This function checks if the command is recognized and conforms to the expected format.
+ * This function checks if the command is recognized and conforms to the expected format:
+ * '#', the opcode and its arguments (see command_forms in UART.c), a checksum from 000
+ * to 255 and '!'. It needs no memory besides its stack.
  *
  * @param command String representing the command to be validated.
  *
  * @return Indicates the result of the command validation.
- *         REGEX_COMPILE_FAIL - fails to compile the regex pattern.
  *         VALID_COMMAND - the command is valid.
  *         INVALID_COMMAND - the command is invalid.
- *         REGEX_MATCH_FAIL - fails the matching process.
  *
  */
 uint16_t validate_command(char *command);
@@ -128,23 +309,84 @@ uint16_t validate_command(char *command);
  */
 uint16_t validate_checksum(char *command, uint16_t rx_occupied_bytes);
 
+/**
+ * @brief Length of the command held by a UART data item.
+ *
+ * @param item UART data item, the command may wrap around the end of the RX buffer.
+ *
+ * @return uint16_t Number of chars from the start of frame to the end of frame.
+ */
+uint16_t uart_command_len(const struct uart_data_item_t *item);
+
+/**
+ * @brief Extract the command held by a UART data item.
+ *
+ * Copies the command out of the (circular) RX buffer copy and terminates it.
+ *
+ * @param item UART data item.
+ * @param command Destination, at least uart_command_len() + 1 bytes.
+ *
+ * @return uint16_t Length of the command.
+ */
+uint16_t uart_extract_command(const struct uart_data_item_t *item, uint8_t *command);
+
+/**
+ * @brief Lane of the command held by a UART data item.
+ *
+ * LED writes ('L' with a value or a mask, 'P' with a duty, 'K' and 'Q') and capture
+ * command triggers ('CT') are urgent, all the other commands are bulk.
+ *
+ * @param item UART data item.
+ *
+ * @return uint8_t UART_LANE_URGENT or UART_LANE_BULK.
+ */
+uint8_t uart_command_lane(const struct uart_data_item_t *item);
+
 /**
  * @brief Thread function to process UART data from the FIFO.
  *
- * This thread function continuously retrieves UART data items from a FIFO,
- * extracts commands from the received data, and processes the commands.
+ * This thread function continuously retrieves UART data items from the lanes
+ * of a session (urgent first, see UART_URGENT_BURST), extracts commands from
+ * the received data, processes the commands and replies on the same session.
  *  
  * The supported commands are:
  *      - 'B': Read the status of a button.
- *      - 'L': Read or set the status of an LED.
+ *      - 'L': Read or set the status of an LED, read every LED ('A'), or set several LEDs at once
+ *             ('M', 4-bit mask then 4-bit status, LED 0 first) in one RTDB transaction.
  *      - 'A': Read ADC values (raw or processed).
+ *      - 'E': Drain the event log (button gestures, deadline misses).
+ *      - 'G': Read or set the gesture timings ('L' long-press, 'D' double-click, in ms).
+ *      - 'P': Read the PWM configuration of an LED or set its brightness (0-100 %).
+ *      - 'K': Blink an LED with the given period (ms).
+ *      - 'Q': Load an on/off pattern (up to 16 steps) and its step duration (ms) on an LED.
+ *      - 'J': Report the release jitter of every periodic task.
+ *      - 'T': Read or set the period of a periodic task (ms).
+ *      - 'S': Report the execution time, jitter and response time statistics of a task, 'R' suffix resets them.
+ *      - 'D': Read or set the relative deadline (ms, 0 follows the period) and overrun policy ('S' skip, 'C' catch-up) of a task.
+ *      - 'M': Report memory telemetry (stack high-water marks, heap usage and peak, pool watermarks).
+ *      - 'O': Read the operating mode and wakeup counters, or set the mode ('0' periodic, '1' event-driven).
+ *      - 'R': Dump the event trace in binary and clear it, or stop ('0') / restart ('1') recording (CONFIG_APP_TRACE).
+ *      - 'I': Report the link statistics of every UART session and the latency of its command lanes.
+ *      - 'H': Report the wait and service time histograms of each command class on this session
+ *             (B, L read, L write, AR, AV, other), up to the reply being queued, 'R' suffix resets them.
+ *      - 'V': List the log level of every module, or set the level of a module (index, then 0 off to 4 debug).
+ *      - 'Z': Run the parser/checksum/RTDB/ADC self-test and benchmark (CONFIG_APP_SELFTEST).
+ *      - 'C': ADC capture (CONFIG_APP_CAPTURE): report its state, arm it ('A', trigger type 'H'/'L' level,
+ *             'R'/'F' edge, 'B' button, 'C' command, then a 4-digit level or button index), trigger it ('T'),
+ *             download the frozen capture in binary ('D') or stop it ('S').
+ *      - 'Y': Sensor replay (CONFIG_APP_REPLAY): report its state, play the trace ('P') or stop ('S'),
+ *             start ('R') or end ('E') recording the inputs, dump the recording as a trace ('D').
+ *      - 'U': Rules engine (CONFIG_APP_RULES): list the rules, clear them all ('C'), clear a slot (2 digits)
+ *             or compile a rule into it (slot, then the rule text, see rules.h).
+ *      - 'W': Stored configuration (CONFIG_APP_PERSIST): report the store state, write the pending changes
+ *             now ('S') or erase the stored configuration ('E', defaults on the next boot).
  * 
- * @param argA Unused parameter.
+ * @param argA Session (struct uart_session_t *).
  * @param argB Unused parameter.
  * @param argC Unused parameter.
  *
- * @warning This function uses dynamic memory allocation with `malloc` and `free`.
- * Ensure sufficient heap memory is available and consider potential fragmentation.
+ * @note The command is extracted to a buffer on the thread stack and the frame
+ * is returned to the pool of the session once processed.
  */
 void fifo_thread_code(void *argA , void *argB, void *argC);
 
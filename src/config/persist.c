@@ -0,0 +1,348 @@
+/**
+ * @file persist.c
+ * @brief Persistence of the runtime configuration across reboots.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "persist.h"
+#include "../sensors/rtdb.h"
+#include "../sensors/leds.h"
+#include "../sensors/gestures.h"
+#include "../sensors/rules.h"
+#include "../sched/executive.h"
+#include "../sched/opmode.h"
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(app_persist, CONFIG_APP_PERSIST_LOG_LEVEL);
+
+/**
+ * @struct persist_task_t
+ *
+ * @brief Stored configuration of a task, found back by its ID.
+ */
+struct persist_task_t {
+    char id;
+    uint8_t policy;
+    uint16_t reserved;
+    uint32_t period_ms;
+    uint32_t deadline_ms;
+};
+
+#if defined(CONFIG_APP_RULES)
+#define PERSIST_RULES_SIZE (CONFIG_APP_RULES_MAX * RULE_TEXT_SIZE)
+#else
+#define PERSIST_RULES_SIZE 0
+#endif
+
+/* Largest group value */
+#define PERSIST_VALUE_MAX MAX(PERSIST_RULES_SIZE, EXEC_MAX_TASKS * sizeof(struct persist_task_t))
+
+/* Value of a group: collected from the modules before a write, applied to them on restore */
+static uint8_t persist_buf[PERSIST_VALUE_MAX];
+static struct exec_task_t persist_task;
+
+static size_t persist_leds_collect(uint8_t *buf) {
+    uint32_t values;
+    rtdb_read_leds(&values);
+    buf[0] = values;
+    return 1;
+}
+
+static void persist_leds_apply(const uint8_t *buf, size_t len) {
+    struct rtdb_leds_txn_t txn;
+    rtdb_leds_txn_begin(&txn);
+    for(int i = 0; i < N_LEDS && len == 1; i++) {
+        rtdb_leds_txn_stage(&txn, i, (buf[0] >> i) & 1);
+    }
+    rtdb_leds_txn_commit(&txn);
+}
+
+static size_t persist_tasks_collect(uint8_t *buf) {
+    struct persist_task_t *tasks = (struct persist_task_t *)buf;
+    int n = exec_task_count();
+    for(int i = 0; i < n; i++) {
+        exec_task_get(i, &persist_task);
+        tasks[i] = (struct persist_task_t){
+            .id = persist_task.id,
+            .policy = persist_task.policy,
+            .period_ms = persist_task.period_ms,
+            .deadline_ms = persist_task.deadline_ms,
+        };
+    }
+    return n * sizeof(struct persist_task_t);
+}
+
+static void persist_tasks_apply(const uint8_t *buf, size_t len) {
+    const struct persist_task_t *tasks = (const struct persist_task_t *)buf;
+    for(int i = 0; i < len / sizeof(struct persist_task_t); i++) {
+        /* Tasks removed since are skipped, out of range values rejected by the setters */
+        int idx = exec_task_find(tasks[i].id);
+        if(idx >= 0) {
+            exec_set_period(idx, tasks[i].period_ms);
+            exec_set_deadline(idx, tasks[i].deadline_ms, tasks[i].policy);
+        }
+    }
+}
+
+static size_t persist_gestures_collect(uint8_t *buf) {
+    int timing[2];
+    gestures_get_timing(&timing[0], &timing[1]);
+    memcpy(buf, timing, sizeof(timing));
+    return sizeof(timing);
+}
+
+static void persist_gestures_apply(const uint8_t *buf, size_t len) {
+    int timing[2];
+    if(len == sizeof(timing)) {
+        memcpy(timing, buf, sizeof(timing));
+        gestures_set_long_press(timing[0]);
+        gestures_set_double_click(timing[1]);
+    }
+}
+
+static size_t persist_mode_collect(uint8_t *buf) {
+    buf[0] = opmode_get();
+    return 1;
+}
+
+static void persist_mode_apply(const uint8_t *buf, size_t len) {
+    if(len == 1) {
+        opmode_set(buf[0]);
+    }
+}
+
+#if defined(CONFIG_APP_RULES)
+/* One RULE_TEXT_SIZE text per slot, empty for an empty slot */
+static size_t persist_rules_collect(uint8_t *buf) {
+    struct rule_t rule;
+    memset(buf, 0, PERSIST_RULES_SIZE);
+    for(int i = 0; i < CONFIG_APP_RULES_MAX; i++) {
+        if(rules_get(i, &rule) == 0) {
+            rules_format(&rule, (char *)&buf[i * RULE_TEXT_SIZE]);
+        }
+    }
+    return PERSIST_RULES_SIZE;
+}
+
+static void persist_rules_apply(const uint8_t *buf, size_t len) {
+    for(int i = 0; i < CONFIG_APP_RULES_MAX && (i + 1) * RULE_TEXT_SIZE <= len; i++) {
+        const char *text = (const char *)&buf[i * RULE_TEXT_SIZE];
+        int text_len = strnlen(text, RULE_TEXT_SIZE);
+        if(text_len > 0 && rules_set(i, text, text_len) != 0) {
+            LOG_WRN("stored rule %d dropped", i);
+        }
+    }
+}
+#endif
+
+/**
+ * @struct persist_group_t
+ *
+ * @brief Group of settings stored under one key.
+ */
+static const struct persist_group_t {
+    const char *key;
+    size_t (*collect)(uint8_t *buf);
+    void (*apply)(const uint8_t *buf, size_t len);
+} persist_groups[PERSIST_N_GROUPS] = {
+    [PERSIST_LEDS] = { "app/leds", persist_leds_collect, persist_leds_apply },
+    [PERSIST_TASKS] = { "app/tasks", persist_tasks_collect, persist_tasks_apply },
+    [PERSIST_GESTURES] = { "app/gestures", persist_gestures_collect, persist_gestures_apply },
+    [PERSIST_MODE] = { "app/mode", persist_mode_collect, persist_mode_apply },
+#if defined(CONFIG_APP_RULES)
+    [PERSIST_RULES] = { "app/rules", persist_rules_collect, persist_rules_apply },
+#else
+    [PERSIST_RULES] = { "app/rules", NULL, NULL },
+#endif
+};
+
+#define PERSIST_PREFIX_LEN 4    /* "app/" */
+
+/* CRC of the value stored for each group, valid for the groups in persist_stored */
+static uint32_t persist_crc[PERSIST_N_GROUPS];
+static uint32_t persist_stored;
+
+static atomic_t persist_dirty = ATOMIC_INIT(0);
+static bool persist_ready;
+static uint32_t persist_restored;
+static uint32_t persist_writes;
+static uint32_t persist_unchanged;
+static uint32_t persist_errors;
+static int64_t persist_last_batch_ms = -1;
+
+/* Serializes the batches, the commands and the restore */
+static K_MUTEX_DEFINE(persist_lock);
+
+static void persist_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(persist_work, persist_work_handler);
+
+static int persist_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg) {
+
+    for(int g = 0; g < PERSIST_N_GROUPS; g++) {
+        const struct persist_group_t *group = &persist_groups[g];
+        if(group->apply == NULL || !settings_name_steq(name, group->key + PERSIST_PREFIX_LEN, NULL)) {
+            continue;
+        }
+        if(len > sizeof(persist_buf)) {
+            LOG_WRN("stored %s too long (%u bytes), ignored", group->key, (unsigned int)len);
+            return -EINVAL;
+        }
+        ssize_t n = read_cb(cb_arg, persist_buf, len);
+        if(n < 0) {
+            return n;
+        }
+        group->apply(persist_buf, n);
+        persist_crc[g] = crc32_ieee(persist_buf, n);
+        persist_stored |= BIT(g);
+        persist_restored++;
+        return 0;
+    }
+    return -ENOENT;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(app_persist, "app", NULL, persist_settings_set, NULL, NULL);
+
+/* Writes the dirty groups whose value changed, returns 0 or the last error */
+static int persist_write_dirty(void) {
+
+    int ret = 0;
+    bool wrote = false;
+
+    k_mutex_lock(&persist_lock, K_FOREVER);
+    uint32_t dirty = atomic_clear(&persist_dirty);
+    for(int g = 0; g < PERSIST_N_GROUPS; g++) {
+        const struct persist_group_t *group = &persist_groups[g];
+        if(!(dirty & BIT(g)) || group->collect == NULL) {
+            continue;
+        }
+
+        size_t len = group->collect(persist_buf);
+        uint32_t crc = crc32_ieee(persist_buf, len);
+        if((persist_stored & BIT(g)) && crc == persist_crc[g]) {
+            /* Changed back, or rewritten with the same value: no flash write */
+            persist_unchanged++;
+            continue;
+        }
+
+        int err = settings_save_one(group->key, persist_buf, len);
+        if(err) {
+            /* Stays dirty, retried below */
+            LOG_ERR("cannot write %s (error %d)", group->key, err);
+            atomic_or(&persist_dirty, BIT(g));
+            persist_errors++;
+            ret = err;
+            continue;
+        }
+        persist_crc[g] = crc;
+        persist_stored |= BIT(g);
+        persist_writes++;
+        wrote = true;
+    }
+    if(wrote) {
+        persist_last_batch_ms = k_uptime_get();
+    }
+    if(ret) {
+        /* No later change may come to schedule a batch: retry after the min
+           interval, not sooner, a failing flash is not hammered */
+        k_work_schedule(&persist_work, K_MSEC(CONFIG_APP_PERSIST_MIN_INTERVAL_MS));
+    }
+    k_mutex_unlock(&persist_lock);
+
+    return ret;
+}
+
+static void persist_work_handler(struct k_work *work) {
+
+    /* Batches are spaced by at least the min interval, to bound the flash wear */
+    int64_t wait = 0;
+    k_mutex_lock(&persist_lock, K_FOREVER);
+    if(persist_last_batch_ms >= 0) {
+        wait = persist_last_batch_ms + CONFIG_APP_PERSIST_MIN_INTERVAL_MS - k_uptime_get();
+    }
+    k_mutex_unlock(&persist_lock);
+
+    if(wait > 0) {
+        k_work_schedule(&persist_work, K_MSEC(wait));
+        return;
+    }
+    persist_write_dirty();
+}
+
+int persist_init(void) {
+
+    int err = settings_subsys_init();
+    if(err) {
+        LOG_ERR("settings_subsys_init() failed with error code %d", err);
+        return err;
+    }
+
+    k_mutex_lock(&persist_lock, K_FOREVER);
+    err = settings_load_subtree("app");
+    /* The restore went through the setters: nothing new to write */
+    atomic_clear(&persist_dirty);
+    persist_ready = true;
+    k_mutex_unlock(&persist_lock);
+
+    if(err) {
+        LOG_ERR("settings_load_subtree() failed with error code %d", err);
+    }
+    LOG_INF("%u configuration groups restored", (unsigned int)persist_restored);
+    return err;
+}
+
+void persist_touch(int group) {
+    atomic_or(&persist_dirty, BIT(group));
+    if(persist_ready) {
+        /* Already scheduled: the change joins the pending batch */
+        k_work_schedule(&persist_work, K_MSEC(CONFIG_APP_PERSIST_DELAY_MS));
+    }
+}
+
+int persist_flush(void) {
+    return persist_write_dirty();
+}
+
+int persist_erase(void) {
+
+    int ret = 0;
+
+    k_mutex_lock(&persist_lock, K_FOREVER);
+    k_work_cancel_delayable(&persist_work);
+    atomic_clear(&persist_dirty);
+    for(int g = 0; g < PERSIST_N_GROUPS; g++) {
+        int err = settings_delete(persist_groups[g].key);
+        if(err) {
+            LOG_ERR("cannot delete %s (error %d)", persist_groups[g].key, err);
+            ret = err;
+        }
+    }
+    persist_stored = 0;
+    k_mutex_unlock(&persist_lock);
+
+    return ret;
+}
+
+void persist_info_get(struct persist_info_t *info) {
+    k_mutex_lock(&persist_lock, K_FOREVER);
+    info->dirty = atomic_get(&persist_dirty);
+    info->restored = persist_restored;
+    info->writes = persist_writes;
+    info->unchanged = persist_unchanged;
+    info->errors = persist_errors;
+    info->last_batch_ms = persist_last_batch_ms;
+    k_mutex_unlock(&persist_lock);
+}
+
+const char *persist_group_name(int group) {
+    if(group < 0 || group >= PERSIST_N_GROUPS) {
+        return "?";
+    }
+    return persist_groups[group].key + PERSIST_PREFIX_LEN;
+}
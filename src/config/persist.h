@@ -0,0 +1,118 @@
+/**
+ * @file persist.h
+ * @brief Persistence of the runtime configuration across reboots.
+ *
+ * This header file declares the warm-start store, enabled with
+ * CONFIG_APP_PERSIST, that keeps the runtime configuration in flash through
+ * the Zephyr settings subsystem (NVS backend, flash simulator on native_sim)
+ * and restores it at boot, before the executive starts the sensor tasks.
+ *
+ * The configuration is stored as a few groups, one settings key each:
+ *
+ *     app/leds      LED statuses of the RTDB
+ *     app/tasks     period, deadline and overrun policy of every task
+ *     app/gestures  long-press and double-click timings
+ *     app/mode      operating mode (periodic or event-driven)
+ *     app/rules     rules engine slots (CONFIG_APP_RULES)
+ *
+ * Setters only mark their group dirty (persist_touch()). The dirty groups are
+ * written together, CONFIG_APP_PERSIST_DELAY_MS after the first change and
+ * at least CONFIG_APP_PERSIST_MIN_INTERVAL_MS after the previous batch, so a
+ * burst of changes costs one write per group. A group whose value did not
+ * change since it was last stored (same CRC) is not written at all.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __PERSIST_H__
+#define __PERSIST_H__
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+/* Groups */
+#define PERSIST_LEDS 0
+#define PERSIST_TASKS 1
+#define PERSIST_GESTURES 2
+#define PERSIST_MODE 3
+#define PERSIST_RULES 4
+#define PERSIST_N_GROUPS 5
+
+/**
+ * @struct persist_info_t
+ *
+ * @brief State and counters of the store.
+ */
+struct persist_info_t {
+    uint32_t dirty;         /* Groups waiting for the next batch (bit i is group i) */
+    uint32_t restored;      /* Groups restored at boot */
+    uint32_t writes;        /* Groups written */
+    uint32_t unchanged;     /* Dirty groups not written, value already stored */
+    uint32_t errors;        /* Failed writes (the group stays dirty, retried after the min interval) */
+    int64_t last_batch_ms;  /* Uptime of the last batch that wrote, -1 if none */
+};
+
+/**
+ * @brief Writes the dirty groups now, ignoring the batching delays.
+ *
+ * @return int 0 on success, a negative error code if a group could not be written.
+ */
+int persist_flush(void);
+
+/**
+ * @brief Deletes the stored configuration, the next boot starts with the defaults.
+ *
+ * @return int 0 on success, a negative error code if a key could not be deleted.
+ */
+int persist_erase(void);
+
+/**
+ * @brief Gets the state and counters of the store.
+ *
+ * @param info Destination.
+ */
+void persist_info_get(struct persist_info_t *info);
+
+/**
+ * @brief Name of a group (settings key without the "app/" prefix).
+ *
+ * @param group Group (PERSIST_*).
+ *
+ * @return const char* Name, "?" if the group is invalid.
+ */
+const char *persist_group_name(int group);
+
+/* Hooks of main() and of the setters, no-ops without CONFIG_APP_PERSIST */
+#if defined(CONFIG_APP_PERSIST)
+
+/**
+ * @brief Restores the stored configuration.
+ *
+ * To be called after the tasks are registered, before the UART sessions
+ * (a command would race with the restore and be overwritten by it) and
+ * before the executive starts. Changes are only written from then on.
+ *
+ * @return int 0 on success, a negative error code if the store is unavailable.
+ */
+int persist_init(void);
+
+/**
+ * @brief Marks a group dirty, it is written with the next batch.
+ *
+ * Cheap and callable from any thread: the write runs on the system work queue.
+ *
+ * @param group Group (PERSIST_*).
+ */
+void persist_touch(int group);
+
+#else
+
+static inline int persist_init(void) { return 0; }
+static inline void persist_touch(int group) { }
+
+#endif
+
+#endif
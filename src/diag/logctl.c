@@ -0,0 +1,76 @@
+/**
+ * @file logctl.c
+ * @brief Runtime log levels of the application modules.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "logctl.h"
+#include <zephyr/logging/log_ctrl.h>
+
+/* Modules registered with LOG_MODULE_REGISTER() by the application */
+static const char *const logctl_modules[] = {
+    "app_uart",
+    "app_adc",
+    "app_gpio_bank",
+    "app_replay",
+    "app_persist",
+};
+
+/* Runtime levels plus one, 0 until set (the compiled level applies): zero
+   initialized whatever the number of modules */
+static uint8_t logctl_levels[ARRAY_SIZE(logctl_modules)];
+
+int logctl_count(void) {
+    return ARRAY_SIZE(logctl_modules);
+}
+
+const char *logctl_name(int idx) {
+    if(idx < 0 || idx >= ARRAY_SIZE(logctl_modules)) {
+        return NULL;
+    }
+    return logctl_modules[idx];
+}
+
+int logctl_get(int idx) {
+    if(idx < 0 || idx >= ARRAY_SIZE(logctl_modules)) {
+        return -EINVAL;
+    }
+    if(logctl_levels[idx] > 0) {
+        return logctl_levels[idx] - 1;
+    }
+    int source_id = log_source_id_get(logctl_modules[idx]);
+    if(source_id < 0) {
+        return LOG_LEVEL_NONE;
+    }
+    return log_filter_get(NULL, Z_LOG_LOCAL_DOMAIN_ID, source_id, false);
+}
+
+int logctl_set(int idx, int level) {
+    if(idx < 0 || idx >= ARRAY_SIZE(logctl_modules) || level < LOG_LEVEL_NONE || level > LOG_LEVEL_DBG) {
+        return -EINVAL;
+    }
+#if defined(CONFIG_LOG_RUNTIME_FILTERING)
+    int source_id = log_source_id_get(logctl_modules[idx]);
+    if(source_id < 0) {
+        return -EINVAL;
+    }
+    /* Applies to every backend, returns the level actually set */
+    int set = log_filter_set(NULL, Z_LOG_LOCAL_DOMAIN_ID, source_id, level);
+    logctl_levels[idx] = set + 1;
+    return set;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+const char *logctl_level_name(int level) {
+    static const char *const names[] = { "OFF", "ERR", "WRN", "INF", "DBG" };
+    if(level < LOG_LEVEL_NONE || level > LOG_LEVEL_DBG) {
+        return "?";
+    }
+    return names[level];
+}
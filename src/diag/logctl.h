@@ -0,0 +1,74 @@
+/**
+ * @file logctl.h
+ * @brief Runtime log levels of the application modules.
+ *
+ * Diagnostics use the Zephyr logging subsystem in deferred mode: a log call
+ * only stores its arguments and the formatting is done by the low priority
+ * logging thread. The output goes to a backend other than the protocol UART
+ * (RTT on the nRF board, the process stdout on native_sim).
+ *
+ * This header file declares functions to read and change, at runtime, the
+ * level of each application module (requires CONFIG_LOG_RUNTIME_FILTERING).
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __LOGCTL_H__
+#define __LOGCTL_H__
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+/**
+ * @brief Number of application modules with a log level.
+ *
+ * @return int Number of modules.
+ */
+int logctl_count(void);
+
+/**
+ * @brief Name of a module.
+ *
+ * @param idx Module index.
+ *
+ * @return const char* Module name, NULL if the index is not valid.
+ */
+const char *logctl_name(int idx);
+
+/**
+ * @brief Current log level of a module.
+ *
+ * @param idx Module index.
+ *
+ * @return int Level (LOG_LEVEL_NONE to LOG_LEVEL_DBG), or -EINVAL.
+ */
+int logctl_get(int idx);
+
+/**
+ * @brief Set the log level of a module.
+ *
+ * The level is capped at the level the module was compiled with.
+ *
+ * @param idx Module index.
+ * @param level Level (LOG_LEVEL_NONE to LOG_LEVEL_DBG).
+ *
+ * @return int
+ * - Returns the level applied.
+ * - Returns -EINVAL if the module or the level is not valid.
+ * - Returns -ENOTSUP without runtime filtering.
+ */
+int logctl_set(int idx, int level);
+
+/**
+ * @brief Short name of a log level.
+ *
+ * @param level Level.
+ *
+ * @return const char* "OFF", "ERR", "WRN", "INF" or "DBG".
+ */
+const char *logctl_level_name(int level);
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @file memtel.c
+ * @brief Memory telemetry: stack high-water marks, heap usage and pool watermarks.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "memtel.h"
+#include <zephyr/sys/sys_heap.h>
+
+#if defined(CONFIG_NEWLIB_LIBC)
+#include <malloc.h>
+#endif
+
+#if defined(CONFIG_HEAP_MEM_POOL_SIZE) && (CONFIG_HEAP_MEM_POOL_SIZE > 0)
+extern struct k_heap _system_heap;
+#endif
+
+/**
+ * @struct memtel_walk_t
+ *
+ * @brief Output array used while walking the thread list.
+ */
+struct memtel_walk_t {
+    struct memtel_thread_t *out;
+    int max;
+    int n;
+};
+
+static void memtel_thread_cb(const struct k_thread *thread, void *user_data) {
+
+    struct memtel_walk_t *walk = user_data;
+    if(walk->n == walk->max) {
+        return;
+    }
+
+    struct memtel_thread_t *t = &walk->out[walk->n];
+    t->name = k_thread_name_get((k_tid_t)thread);
+    if(t->name == NULL || t->name[0] == '\0') {
+        t->name = "?";
+    }
+#if defined(CONFIG_THREAD_STACK_INFO)
+    t->size = thread->stack_info.size;
+#else
+    t->size = 0;
+#endif
+    if(k_thread_stack_space_get(thread, &t->unused) != 0) {
+        t->unused = 0;
+    }
+    walk->n++;
+}
+
+int memtel_threads(struct memtel_thread_t *out, int max) {
+
+    struct memtel_walk_t walk = { .out = out, .max = max, .n = 0 };
+
+    /* Unlocked walk: measuring a stack scans it, keep interrupts enabled meanwhile */
+    k_thread_foreach_unlocked(memtel_thread_cb, &walk);
+
+    return walk.n;
+}
+
+int memtel_kernel_heap(struct memtel_heap_t *out) {
+
+#if defined(CONFIG_HEAP_MEM_POOL_SIZE) && (CONFIG_HEAP_MEM_POOL_SIZE > 0) && defined(CONFIG_SYS_HEAP_RUNTIME_STATS)
+    struct sys_memory_stats stats;
+    sys_heap_runtime_stats_get(&_system_heap.heap, &stats);
+
+    out->size = stats.free_bytes + stats.allocated_bytes;
+    out->used = stats.allocated_bytes;
+    out->max_used = stats.max_allocated_bytes;
+
+    return 0;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+int memtel_libc_heap(struct memtel_heap_t *out) {
+
+#if defined(CONFIG_NEWLIB_LIBC)
+    struct mallinfo info = mallinfo();
+
+    out->size = info.arena;
+    out->used = info.uordblks;
+    out->max_used = 0;
+
+    return 0;
+#else
+    return -ENOTSUP;
+#endif
+}
@@ -0,0 +1,87 @@
+/**
+ * @file memtel.h
+ * @brief Memory telemetry: stack high-water marks, heap usage and pool watermarks.
+ *
+ * This header file declares functions that gather, at runtime, how much of
+ * each thread stack has ever been used, how much of the kernel heap is in use
+ * (now and at its peak) and, when newlib is used, the state of the C library
+ * heap. It is used to right-size memory on deployed units.
+ *
+ * The heap figures come from the public sys_heap runtime statistics only.
+ * They do not include the largest free block, so fragmentation is not
+ * reported: a peak close to the heap size is the sign to look for.
+ *
+ * Stack high-water marks rely on CONFIG_INIT_STACKS (stacks are filled with a
+ * known pattern at creation) and CONFIG_THREAD_STACK_INFO/CONFIG_THREAD_MONITOR.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __MEMTEL_H__
+#define __MEMTEL_H__
+
+#include <zephyr/kernel.h>
+#include <stddef.h>
+
+#define MEMTEL_MAX_THREADS 12   /* Max threads reported */
+
+/**
+ * @struct memtel_thread_t
+ *
+ * @brief Stack usage of a thread.
+ */
+struct memtel_thread_t {
+    const char *name;
+    size_t size;        /* Stack size */
+    size_t unused;      /* Bytes never touched since the thread started */
+};
+
+/**
+ * @struct memtel_heap_t
+ *
+ * @brief Usage of a heap.
+ */
+struct memtel_heap_t {
+    size_t size;            /* Usable bytes */
+    size_t used;            /* Bytes currently allocated */
+    size_t max_used;        /* High-water mark of the allocated bytes */
+};
+
+/**
+ * @brief Gathers the stack usage of every thread.
+ *
+ * @param out Array to store the results.
+ * @param max Size of the array.
+ *
+ * @return int Number of threads stored.
+ */
+int memtel_threads(struct memtel_thread_t *out, int max);
+
+/**
+ * @brief Gathers the usage of the kernel heap (k_malloc).
+ *
+ * Nothing is allocated, so the high-water mark is left untouched.
+ *
+ * @param out Pointer to store the results.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -ENOTSUP if there is no kernel heap or its statistics are disabled.
+ */
+int memtel_kernel_heap(struct memtel_heap_t *out);
+
+/**
+ * @brief Gathers the usage of the C library heap (malloc).
+ *
+ * @param out Pointer to store the results, max_used is not available.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -ENOTSUP if the C library does not report its heap usage.
+ */
+int memtel_libc_heap(struct memtel_heap_t *out);
+
+#endif
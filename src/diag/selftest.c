@@ -0,0 +1,302 @@
+/**
+ * @file selftest.c
+ * @brief Built-in self-test and benchmark of the command and sensor hot paths.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "selftest.h"
+#include "../UART/UART.h"
+#include "../sensors/adc.h"
+#include "../sensors/rtdb.h"
+#include "../sched/cycles.h"
+
+#if defined(CONFIG_NATIVE_LIBRARY)
+/* The simulated time stands still while the benchmark runs: host clock, in
+   ns, reported as both cycles and ns */
+#include "selftest_host.h"
+typedef unsigned long long selftest_stamp_t;
+#define selftest_clock_init() do { } while (0)
+#define selftest_now() selftest_host_now_ns()
+#define selftest_cycles(start, end) ((end) - (start))
+#define selftest_to_ns(start, end) ((end) - (start))
+#else
+typedef cycles_stamp_t selftest_stamp_t;
+#define selftest_clock_init() cycles_init()
+#define selftest_now() cycles_now()
+#define selftest_cycles(start, end) cycles_delta(start, end)
+#define selftest_to_ns(start, end) cycles_to_ns(start, end)
+#endif
+
+#if defined(CONFIG_BOARD_QEMU_X86) && defined(CONFIG_QEMU_ICOUNT)
+/* The qemu_x86 baselines count 2^5 TSC cycles per instruction */
+BUILD_ASSERT(CONFIG_QEMU_ICOUNT_SHIFT == 5, "qemu_x86 baselines recorded with an icount shift of 5");
+#endif
+
+#define FRAME_MAX (RXBUF_SIZE + 1)
+
+/* Commands accepted by the parser (checksum appended at runtime) */
+static const char *const valid_cmds[] = {
+    "B0", "B3", "L0", "L31", "LA", "LM11000100", "AR", "AV", "E", "G", "GL0800", "GD0400",
+    "P1", "P2100", "K01000", "Q310100250", "J", "TA", "TL01000", "SB", "SBR",
+    "DA", "DA00100C", "M", "O", "O1", "R", "R0", "I", "H", "HR", "V", "V24", "Z",
+    "C", "CAR0512", "CAB0003", "CT", "CD", "CS", "Y", "YP", "YD",
+    "U", "UC", "U07", "U00AH2000F2", "U15AL0100I3", "U01B0T0", "U02EL3S1",
+    "W", "WS", "WE",
+};
+
+/* Commands rejected by the parser even with a correct checksum */
+static const char *const invalid_cmds[] = {
+    "B4", "L4", "L32", "LM1100010", "LM11000102", "A", "AX", "GL080", "P2101", "K0100", "Q3", "Ta",
+    "DA00100X", "O2", "HX", "HR0", "V5", "V15", "C5", "CAX0512", "CA0512", "YX", "YP1",
+    "U7", "U00AX2000F2", "U00AH200F2", "U01B4T0", "U01B0X0", "U02EX3S1", "U02EL3S4", "WX", "WS0", "X", "",
+};
+
+/* Malformed frames */
+static const char *const malformed_frames[] = {
+    "B0114!", "#B0114", "#B0256!", "#B011!", "#B0 114!", "##B0114!", "#b0114!",
+};
+
+/* Builds '#<cmd><checksum>!' with the checksum computed as the firmware does */
+static int selftest_frame(char *frame, const char *cmd, int checksum_offset) {
+    int sum = 0;
+    for(const char *c = cmd; *c; c++) {
+        sum += *c;
+    }
+    sum = (sum + checksum_offset + 256) % 256;
+    return snprintf(frame, FRAME_MAX, "%c%s%03d%c", SOF_SYM, cmd, sum, EOF_SYM);
+}
+
+static void selftest_expect(struct selftest_check_t *check, bool cond, const char *what) {
+    check->total++;
+    if(!cond) {
+        check->failures++;
+        check->detail = what;
+    }
+}
+
+static void check_valid_frames(struct selftest_check_t *check) {
+    char frame[FRAME_MAX];
+    for(int i = 0; i < ARRAY_SIZE(valid_cmds); i++) {
+        int len = selftest_frame(frame, valid_cmds[i], 0);
+        selftest_expect(check, validate_command(frame) == VALID_COMMAND &&
+                        validate_checksum(frame, len) == CHECKSUM_MATCH, valid_cmds[i]);
+    }
+}
+
+static void check_invalid_frames(struct selftest_check_t *check) {
+    char frame[FRAME_MAX];
+    for(int i = 0; i < ARRAY_SIZE(invalid_cmds); i++) {
+        selftest_frame(frame, invalid_cmds[i], 0);
+        selftest_expect(check, validate_command(frame) == INVALID_COMMAND, invalid_cmds[i]);
+    }
+    for(int i = 0; i < ARRAY_SIZE(malformed_frames); i++) {
+        strcpy(frame, malformed_frames[i]);
+        selftest_expect(check, validate_command(frame) == INVALID_COMMAND, malformed_frames[i]);
+    }
+}
+
+static void check_checksums(struct selftest_check_t *check) {
+    char frame[FRAME_MAX];
+    int len;
+
+    /* Off by one on both sides */
+    len = selftest_frame(frame, "B0", 1);
+    selftest_expect(check, validate_checksum(frame, len) == CHECKSUM_MISMATCH, "B0+1");
+    len = selftest_frame(frame, "B0", -1);
+    selftest_expect(check, validate_checksum(frame, len) == CHECKSUM_MISMATCH, "B0-1");
+
+    /* Sums past 255 wrap around: TA01000 adds up to 390 */
+    len = selftest_frame(frame, "TA01000", 0);
+    selftest_expect(check, strcmp(frame, "#TA01000134!") == 0 &&
+                    validate_checksum(frame, len) == CHECKSUM_MATCH, "TA01000");
+
+    /* Edges of the checksum range: 255 and 768 (wraps to 000) */
+    len = selftest_frame(frame, "SZR", 0);
+    selftest_expect(check, strcmp(frame, "#SZR255!") == 0 &&
+                    validate_command(frame) == VALID_COMMAND &&
+                    validate_checksum(frame, len) == CHECKSUM_MATCH, "SZR");
+    len = selftest_frame(frame, "Q00000000000069", 0);
+    selftest_expect(check, strcmp(frame, "#Q00000000000069000!") == 0 &&
+                    validate_command(frame) == VALID_COMMAND &&
+                    validate_checksum(frame, len) == CHECKSUM_MATCH, "Q00000000000069");
+}
+
+/* Places a frame in an RX buffer copy starting at the given index */
+static void selftest_item(struct uart_data_item_t *item, const char *frame, int start) {
+    int len = strlen(frame);
+    memset(item->rx_chars, 'x', RXBUF_SIZE);
+    for(int i = 0; i < len; i++) {
+        item->rx_chars[(start + i) % RXBUF_SIZE] = frame[i];
+    }
+    item->rx_buf_start = start;
+    item->rx_buf_end = (start + len - 1) % RXBUF_SIZE;
+}
+
+static void check_extraction(struct selftest_check_t *check) {
+    static const char *const frame = "#TA01000134!";
+    static const int starts[] = {0, 10, RXBUF_SIZE - 12, RXBUF_SIZE - 11, RXBUF_SIZE - 5, RXBUF_SIZE - 1};
+    static struct uart_data_item_t item;
+    uint8_t command[FRAME_MAX];
+
+    for(int i = 0; i < ARRAY_SIZE(starts); i++) {
+        selftest_item(&item, frame, starts[i]);
+        uint16_t len = uart_extract_command(&item, command);
+        selftest_expect(check, len == strlen(frame) && uart_command_len(&item) == len &&
+                        strcmp((char *)command, frame) == 0, frame);
+    }
+}
+
+static void check_lanes(struct selftest_check_t *check) {
+    static const struct {
+        const char *cmd;
+        uint8_t lane;
+    } cases[] = {
+        { "L31", UART_LANE_URGENT }, { "LM11110000", UART_LANE_URGENT }, { "LA", UART_LANE_BULK },
+        { "P2100", UART_LANE_URGENT }, { "K01000", UART_LANE_URGENT },
+        { "Q310100250", UART_LANE_URGENT }, { "L3", UART_LANE_BULK }, { "P2", UART_LANE_BULK },
+        { "B0", UART_LANE_BULK }, { "AR", UART_LANE_BULK }, { "M", UART_LANE_BULK },
+        { "CT", UART_LANE_URGENT }, { "CD", UART_LANE_BULK },
+    };
+    static struct uart_data_item_t item;
+    char frame[FRAME_MAX];
+
+    for(int i = 0; i < ARRAY_SIZE(cases); i++) {
+        selftest_frame(frame, cases[i].cmd, 0);
+        selftest_item(&item, frame, RXBUF_SIZE - 2);
+        selftest_expect(check, uart_command_lane(&item) == cases[i].lane, cases[i].cmd);
+    }
+}
+
+/* Read-only: the RTDB is live while '#Z' runs */
+static void check_rtdb(struct selftest_check_t *check) {
+    int value;
+    uint32_t leds;
+
+    for(int i = 0; i < 4; i++) {
+        rtdb_read_button(i, &value);
+        selftest_expect(check, value == 0 || value == 1, "button");
+        rtdb_read_led(i, &value);
+        selftest_expect(check, value == 0 || value == 1, "led");
+    }
+    rtdb_read_leds(&leds);
+    selftest_expect(check, (leds & ~BIT_MASK(4)) == 0, "leds");
+    rtdb_read_adc_raw(&value);
+    selftest_expect(check, value >= 0 && value <= 1023, "adc_raw");
+}
+
+static void check_adc_conversion(struct selftest_check_t *check) {
+    selftest_expect(check, adc_raw_to_mv(0) == 0, "0");
+    selftest_expect(check, adc_raw_to_mv(512) == 1501, "512");
+    selftest_expect(check, adc_raw_to_mv(1023) == 3000, "1023");
+
+    int prev = 0;
+    bool monotonic = true;
+    for(int raw = 1; raw <= 1023; raw++) {
+        int mv = adc_raw_to_mv(raw);
+        if(mv < prev || mv > 3000) {
+            monotonic = false;
+        }
+        prev = mv;
+    }
+    selftest_expect(check, monotonic, "monotonic");
+}
+
+int selftest_checks(struct selftest_check_t *checks, int max) {
+
+    static const struct {
+        const char *name;
+        void (*run)(struct selftest_check_t *check);
+    } groups[] = {
+        { "VALID FRAMES", check_valid_frames },
+        { "INVALID FRAMES", check_invalid_frames },
+        { "CHECKSUM", check_checksums },
+        { "EXTRACTION", check_extraction },
+        { "LANES", check_lanes },
+        { "RTDB", check_rtdb },
+        { "ADC CONVERSION", check_adc_conversion },
+    };
+
+    int n = MIN(max, ARRAY_SIZE(groups));
+    for(int i = 0; i < n; i++) {
+        checks[i] = (struct selftest_check_t){ .name = groups[i].name };
+        groups[i].run(&checks[i]);
+    }
+    return n;
+}
+
+/* Benchmarked operations, each runs once per call */
+static char bench_frame[FRAME_MAX];
+static int bench_frame_len;
+static struct uart_data_item_t bench_item;
+static volatile int bench_sink;
+
+static void bench_parse(void) {
+    bench_sink = validate_command(bench_frame);
+}
+
+static void bench_checksum(void) {
+    bench_sink = validate_checksum(bench_frame, bench_frame_len);
+}
+
+static void bench_extract(void) {
+    uint8_t command[FRAME_MAX];
+    bench_sink = uart_extract_command(&bench_item, command);
+}
+
+static void bench_rtdb_read(void) {
+    int value;
+    rtdb_read_adc_raw(&value);
+    bench_sink = value;
+}
+
+static void bench_adc_conv(void) {
+    bench_sink = adc_raw_to_mv(bench_sink & 0x3FF);
+}
+
+int selftest_bench(struct selftest_bench_t *bench, int max) {
+
+    static const struct {
+        const char *name;
+        void (*op)(void);
+        uint32_t baseline_cycles;
+    } ops[] = {
+        { "PARSE", bench_parse, SELFTEST_BASE_PARSE_CYC },
+        { "CHECKSUM", bench_checksum, SELFTEST_BASE_CHECKSUM_CYC },
+        { "EXTRACT", bench_extract, SELFTEST_BASE_EXTRACT_CYC },
+        { "RTDB READ", bench_rtdb_read, SELFTEST_BASE_RTDB_READ_CYC },
+        { "ADC CONV", bench_adc_conv, SELFTEST_BASE_ADC_CONV_CYC },
+    };
+
+    /* Typical frame, extracted across the end of the RX buffer */
+    bench_frame_len = selftest_frame(bench_frame, "TA01000", 0);
+    selftest_item(&bench_item, bench_frame, RXBUF_SIZE - 5);
+
+    selftest_clock_init();
+
+    int n = MIN(max, ARRAY_SIZE(ops));
+    for(int i = 0; i < n; i++) {
+        selftest_stamp_t start, end;
+
+        k_sched_lock();
+        bench_sink = 512;
+
+        start = selftest_now();
+        for(int j = 0; j < CONFIG_APP_SELFTEST_ITERATIONS; j++) {
+            ops[i].op();
+        }
+        end = selftest_now();
+        k_sched_unlock();
+
+        bench[i].name = ops[i].name;
+        bench[i].cycles = (uint32_t)(selftest_cycles(start, end) / CONFIG_APP_SELFTEST_ITERATIONS);
+        bench[i].ns = (uint32_t)(selftest_to_ns(start, end) / CONFIG_APP_SELFTEST_ITERATIONS);
+        bench[i].baseline_cycles = ops[i].baseline_cycles;
+        bench[i].regressed = ops[i].baseline_cycles &&
+            (uint64_t)bench[i].cycles * 100 > (uint64_t)ops[i].baseline_cycles * (100 + CONFIG_APP_SELFTEST_TOLERANCE);
+    }
+    return n;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file selftest.h
+ * @brief Built-in self-test and benchmark of the command and sensor hot paths.
+ *
+ * This header file declares a self-test, enabled with CONFIG_APP_SELFTEST and
+ * run with the '#Z' command, that covers the code every command or sample
+ * goes through: frame validation (validate_command), checksum validation
+ * (validate_checksum), command extraction from the circular RX buffer, the
+ * RTDB accessors and the ADC raw to mV conversion.
+ *
+ * The checks verify valid and invalid frames, checksum edge cases and the
+ * extraction of frames that wrap around the end of the RX buffer, and the
+ * command lane (urgent or bulk) each command is queued in. The
+ * benchmark counts the cycles of each operation with the timing API (the
+ * host clock on native_sim) over CONFIG_APP_SELFTEST_ITERATIONS runs and
+ * flags a regression when it takes more than CONFIG_APP_SELFTEST_TOLERANCE %
+ * cycles over its baseline.
+ *
+ * '#Z' runs next to the live tasks, so it only reads the RTDB. The RTDB
+ * writes and transactions are checked by the test suite (tests/selftest),
+ * which runs the same checks and benchmark with no task running: on
+ * native_sim for correctness (timings reported, not checked) and on qemu_x86
+ * with icount, where cycle counts are deterministic, against the baselines.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __SELFTEST_H__
+#define __SELFTEST_H__
+
+#include <zephyr/kernel.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SELFTEST_MAX_CHECKS 8   /* Max check groups reported */
+#define SELFTEST_MAX_BENCH 8    /* Max benchmarked operations reported */
+
+/* Baselines of the benchmarked operations (cycles per operation), 0 when not
+   recorded for the target: the operation is then timed but not checked.
+   Baselines are only recorded where the cycle count is deterministic, not on
+   native_sim (host clock) or on hardware with caches and interrupts: record
+   them from the '#Z' (or test suite) output of a known-good build, e.g. with
+   -DSELFTEST_BASE_PARSE_CYC=... or by editing the values below */
+#if defined(CONFIG_BOARD_QEMU_X86) && defined(CONFIG_QEMU_ICOUNT)
+/* qemu_x86 with icount (shift 5): the TSC advances 32 cycles per instruction,
+   so the counts only change with the code. Instructions counted on an i386
+   -Os build of the same sources. RTDB READ goes through the kernel mutex and
+   ADC CONV through the soft float library, neither is recorded */
+#ifndef SELFTEST_BASE_PARSE_CYC
+#define SELFTEST_BASE_PARSE_CYC 22688       /* 709 instructions */
+#endif
+#ifndef SELFTEST_BASE_CHECKSUM_CYC
+#define SELFTEST_BASE_CHECKSUM_CYC 4736     /* 148 instructions */
+#endif
+#ifndef SELFTEST_BASE_EXTRACT_CYC
+#define SELFTEST_BASE_EXTRACT_CYC 6272      /* 196 instructions */
+#endif
+#endif
+
+#ifndef SELFTEST_BASE_PARSE_CYC
+#define SELFTEST_BASE_PARSE_CYC 0
+#endif
+#ifndef SELFTEST_BASE_CHECKSUM_CYC
+#define SELFTEST_BASE_CHECKSUM_CYC 0
+#endif
+#ifndef SELFTEST_BASE_EXTRACT_CYC
+#define SELFTEST_BASE_EXTRACT_CYC 0
+#endif
+#ifndef SELFTEST_BASE_RTDB_READ_CYC
+#define SELFTEST_BASE_RTDB_READ_CYC 0
+#endif
+#ifndef SELFTEST_BASE_ADC_CONV_CYC
+#define SELFTEST_BASE_ADC_CONV_CYC 0
+#endif
+
+/**
+ * @struct selftest_check_t
+ *
+ * @brief Result of a group of correctness checks.
+ */
+struct selftest_check_t {
+    const char *name;
+    int total;          /* Cases checked */
+    int failures;       /* Cases that failed */
+    const char *detail; /* Last failed case, NULL if none */
+};
+
+/**
+ * @struct selftest_bench_t
+ *
+ * @brief Timing of a benchmarked operation.
+ */
+struct selftest_bench_t {
+    const char *name;
+    uint32_t cycles;            /* Mean cycles per operation (host ns on native_sim) */
+    uint32_t ns;                /* Mean time per operation */
+    uint32_t baseline_cycles;   /* Stored baseline, 0 if not recorded */
+    bool regressed;             /* Slower than the baseline plus the tolerance */
+};
+
+/**
+ * @brief Run the correctness checks.
+ *
+ * @param checks Array filled with one result per check group.
+ * @param max Size of the array.
+ *
+ * @return int Number of check groups reported.
+ */
+int selftest_checks(struct selftest_check_t *checks, int max);
+
+/**
+ * @brief Run the benchmark.
+ *
+ * The benchmarked operations leave the RTDB untouched.
+ *
+ * @param bench Array filled with one result per operation.
+ * @param max Size of the array.
+ *
+ * @return int Number of operations reported.
+ */
+int selftest_bench(struct selftest_bench_t *bench, int max);
+
+#endif
@@ -0,0 +1,18 @@
+/**
+ * @file selftest_host.c
+ * @brief Host clock of the self-test benchmark (native_sim only).
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "selftest_host.h"
+#include <time.h>
+
+unsigned long long selftest_host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
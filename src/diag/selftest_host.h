@@ -0,0 +1,25 @@
+/**
+ * @file selftest_host.h
+ * @brief Host clock of the self-test benchmark (native_sim only).
+ *
+ * Built into the native simulator runner with the host C library. The
+ * native_sim cycle counter follows the simulated time, which does not advance
+ * while the benchmark loops run, so selftest.c times them with the host clock.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __SELFTEST_HOST_H__
+#define __SELFTEST_HOST_H__
+
+/**
+ * @brief Reads the host monotonic clock.
+ *
+ * @return unsigned long long Time in ns.
+ */
+unsigned long long selftest_host_now_ns(void);
+
+#endif
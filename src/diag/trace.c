@@ -0,0 +1,90 @@
+/**
+ * @file trace.c
+ * @brief Low-overhead binary event trace.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "trace.h"
+#include "../sched/cycles.h"
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_APP_TRACE_RING_SIZE), "trace ring size must be a power of two");
+BUILD_ASSERT(sizeof(struct trace_rec_t) == 8, "trace records are sent as 8 bytes");
+
+#define TRACE_RING_MASK (CONFIG_APP_TRACE_RING_SIZE - 1)
+
+/* Ring of a CPU, head counts every reserved slot since the last read */
+struct trace_ring_t {
+    atomic_t head;
+    struct trace_rec_t rec[CONFIG_APP_TRACE_RING_SIZE];
+};
+
+static struct trace_ring_t trace_rings[CONFIG_MP_MAX_NUM_CPUS];
+static atomic_t trace_on = ATOMIC_INIT(1);       /* Recording requested */
+static atomic_t trace_frozen = ATOMIC_INIT(0);   /* Rings being read */
+
+void trace_record(uint8_t event, uint16_t arg) {
+
+    if(!atomic_get(&trace_on) || atomic_get(&trace_frozen)) {
+        return;
+    }
+
+#if CONFIG_MP_MAX_NUM_CPUS > 1
+    uint8_t cpu = arch_curr_cpu()->id;
+#else
+    uint8_t cpu = 0;
+#endif
+    struct trace_ring_t *ring = &trace_rings[cpu];
+
+    /* Reserving the slot is the only shared write, ISRs nesting on the same CPU get the next one */
+    atomic_val_t slot = atomic_inc(&ring->head);
+    struct trace_rec_t *rec = &ring->rec[slot & TRACE_RING_MASK];
+
+    rec->timestamp = (uint32_t)cycles_now();
+    rec->event = event;
+    rec->ctx = cpu | (k_is_in_isr() ? TRACE_CTX_ISR : 0);
+    rec->arg = arg;
+}
+
+void trace_enable(bool enable) {
+    atomic_set(&trace_on, enable);
+}
+
+bool trace_enabled(void) {
+    return atomic_get(&trace_on);
+}
+
+void trace_read_begin(void) {
+    atomic_set(&trace_frozen, 1);
+}
+
+int trace_count(int cpu, uint32_t *lost) {
+    uint32_t head = (uint32_t)atomic_get(&trace_rings[cpu].head);
+    if(head > CONFIG_APP_TRACE_RING_SIZE) {
+        *lost = head - CONFIG_APP_TRACE_RING_SIZE;
+        return CONFIG_APP_TRACE_RING_SIZE;
+    }
+    *lost = 0;
+    return head;
+}
+
+void trace_get(int cpu, int idx, struct trace_rec_t *rec) {
+    uint32_t lost;
+    int count = trace_count(cpu, &lost);
+    uint32_t head = (uint32_t)atomic_get(&trace_rings[cpu].head);
+    *rec = trace_rings[cpu].rec[(head - count + idx) & TRACE_RING_MASK];
+}
+
+void trace_read_end(void) {
+    for(int cpu = 0; cpu < CONFIG_MP_MAX_NUM_CPUS; cpu++) {
+        atomic_set(&trace_rings[cpu].head, 0);
+    }
+    atomic_set(&trace_frozen, 0);
+}
+
+uint32_t trace_hz(void) {
+    return cycles_hz();
+}
@@ -0,0 +1,134 @@
+/**
+ * @file trace.h
+ * @brief Low-overhead binary event trace.
+ *
+ * This header file declares a compile-time optional (CONFIG_APP_TRACE) trace
+ * of fixed-size records: a cycle counter timestamp, an event id and a 16-bit
+ * argument. Records go to a ring per CPU. A slot is reserved with a single
+ * atomic increment, so trace points can be used from interrupts and threads
+ * without locks. When a ring is full the oldest records are overwritten.
+ *
+ * Trace points follow every command from its end of frame in the UART
+ * callback (argument: frame sequence number) through the FIFO, validation
+ * and execution, as well as RTDB accesses (argument: signal and index) and
+ * the jobs of the tasks run by the executive (argument: task id).
+ *
+ * The rings are dumped in binary over the UART with the 'R' command and
+ * decoded on the host by tools/trace/trace_decode.py.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <zephyr/kernel.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Event ids */
+#define TRACE_EVT_UART_RX 1     /* End of frame received, arg: frame sequence number */
+#define TRACE_EVT_CMD_DEQUEUE 2 /* Frame taken from the FIFO, arg: frame sequence number */
+#define TRACE_EVT_CMD_PARSED 3  /* Frame extracted and validated, arg: frame sequence number */
+#define TRACE_EVT_CMD_DONE 4    /* Command executed and replied, arg: frame sequence number */
+#define TRACE_EVT_RTDB_LOCK 5   /* RTDB access started, arg: TRACE_RTDB_ARG() */
+#define TRACE_EVT_RTDB_UNLOCK 6 /* RTDB access ended, arg: TRACE_RTDB_ARG() */
+#define TRACE_EVT_TASK_BEGIN 7  /* Job started, arg: task id */
+#define TRACE_EVT_TASK_END 8    /* Job ended, arg: task id */
+
+/* RTDB signals */
+#define TRACE_RTDB_ADC_RAW 0
+#define TRACE_RTDB_ADC_AN 1
+#define TRACE_RTDB_LED 2
+#define TRACE_RTDB_BUTTON 3
+#define TRACE_RTDB_ALL 0xFF     /* id of an access to every entry of a signal at once */
+#define TRACE_RTDB_ARG(signal, id, write) (((write) << 15) | ((signal) << 8) | (id))
+
+#define TRACE_CTX_ISR 0x80      /* Set in trace_rec_t.ctx for records written by an ISR */
+
+/**
+ * @struct trace_rec_t
+ *
+ * @brief Trace record, sent as is (8 bytes, little endian) by the dump.
+ */
+struct trace_rec_t {
+    uint32_t timestamp; /* Cycle counter (see cycles.h) */
+    uint8_t event;
+    uint8_t ctx;        /* CPU id, TRACE_CTX_ISR if written by an ISR */
+    uint16_t arg;
+};
+
+#if defined(CONFIG_APP_TRACE)
+
+/**
+ * @brief Add a record to the ring of the current CPU.
+ *
+ * @param event Event id (TRACE_EVT_*).
+ * @param arg Event argument.
+ */
+void trace_record(uint8_t event, uint16_t arg);
+
+#define TRACE(event, arg) trace_record((event), (uint16_t)(arg))
+
+#else
+
+#define TRACE(event, arg) do { } while (0)
+
+#endif
+
+/**
+ * @brief Enable or disable the recording of new records.
+ *
+ * @param enable True to record.
+ */
+void trace_enable(bool enable);
+
+/**
+ * @brief Check if records are being recorded.
+ *
+ * @return bool True when recording.
+ */
+bool trace_enabled(void);
+
+/**
+ * @brief Stop recording and freeze the rings for reading.
+ *
+ * Must be followed by trace_read_end().
+ */
+void trace_read_begin(void);
+
+/**
+ * @brief Number of records held in the ring of a CPU.
+ *
+ * @param cpu CPU id.
+ * @param lost Set to the number of records overwritten before they were read.
+ *
+ * @return int Records available, oldest first.
+ */
+int trace_count(int cpu, uint32_t *lost);
+
+/**
+ * @brief Get a record from the ring of a CPU.
+ *
+ * @param cpu CPU id.
+ * @param idx Record index, 0 is the oldest.
+ * @param rec Destination.
+ */
+void trace_get(int cpu, int idx, struct trace_rec_t *rec);
+
+/**
+ * @brief Empty the rings and resume recording if it was enabled.
+ */
+void trace_read_end(void);
+
+/**
+ * @brief Frequency of the trace timestamps.
+ *
+ * @return uint32_t Cycles per second.
+ */
+uint32_t trace_hz(void);
+
+#endif
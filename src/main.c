@@ -1,8 +1,9 @@
 /** @file  main.c
  * @brief Main file that initializes everything necessary
  *
- * Initializes the UART and the FIFO thread responsible for processing commands,
- * configures the ADC/LEDS/Buttons and their respective thread. 
+ * Configures the ADC/LEDS/Buttons, restores the stored configuration, initializes
+ * the UART sessions (each with the thread responsible for processing its commands)
+ * and starts the periodic executive that runs their respective tasks. 
  *
  * @author Diogo Lapa 117296
  * @author Bruno Duarte 118326
@@ -15,6 +16,9 @@
 #include "sensors/adc.h"
 #include "sensors/leds.h"
 #include "sensors/buttons.h"
+#include "sched/executive.h"
+#include "sensors/replay.h"
+#include "config/persist.h"
 
 #include <zephyr/kernel.h>          /* for kernel functions*/
 #include <zephyr/device.h>
@@ -23,29 +27,26 @@
 #include <zephyr/sys/printk.h>
 #include <zephyr/timing/timing.h>   /* for timing services */
 
-/* Size of stack area used by each thread (can be thread specific, if necessary)*/
-#define STACK_SIZE 1024
-#define fifo_thread_priority 1 
-
-K_THREAD_STACK_DEFINE(fifo_thread_stack, STACK_SIZE);
-struct k_thread fifo_thread_data;
-k_tid_t fifo_thread_tid;
-
 /* Main function */
 int main(void)
 {
-    
-    /* UART initialization */
-    uart_init();
 
-    /* Creating FIFO thread */
-    fifo_thread_tid = k_thread_create(&fifo_thread_data, fifo_thread_stack,
-        K_THREAD_STACK_SIZEOF(fifo_thread_stack), fifo_thread_code,
-        NULL, NULL, NULL, fifo_thread_priority, 0, K_NO_WAIT);
-
-    /* Configuring ADC/LEDS/Buttons and creating their threads */
+    /* Configuring ADC/LEDS/Buttons and registering their tasks */
     configure_adc();
     configure_leds();
     configure_buttons();
+
+    /* Warm start: the stored configuration is restored before the tasks run,
+       and before any command can change it */
+    persist_init();
+
+    /* UART initialization, starts the command thread of every session */
+    uart_init();
+
+    /* Replayed inputs (native_sim --replay-file) start with the tasks */
+    replay_init();
+
+    /* All periodic tasks run from the executive thread */
+    exec_start();
  
 }
@@ -0,0 +1,37 @@
+/**
+ * @file cycles.h
+ * @brief Cycle-accurate timestamps for execution time measurements.
+ *
+ * Timestamps come from the timing API when the target has it. native_sim has
+ * no timing functions, so it falls back to the kernel cycle counter.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __CYCLES_H__
+#define __CYCLES_H__
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>   /* for timing services */
+#include <stdint.h>
+
+#if defined(CONFIG_TIMING_FUNCTIONS)
+typedef timing_t cycles_stamp_t;
+#define cycles_init() do { timing_init(); timing_start(); } while (0)
+#define cycles_now() timing_counter_get()
+#define cycles_to_ns(start, end) timing_cycles_to_ns(timing_cycles_get(&(start), &(end)))
+#define cycles_delta(start, end) timing_cycles_get(&(start), &(end))
+#define cycles_hz() ((uint32_t)timing_freq_get())
+#else
+typedef uint32_t cycles_stamp_t;
+#define cycles_init() do { } while (0)
+#define cycles_now() k_cycle_get_32()
+#define cycles_to_ns(start, end) k_cyc_to_ns_floor64((uint32_t)((end) - (start)))
+#define cycles_delta(start, end) ((uint32_t)((end) - (start)))
+#define cycles_hz() ((uint32_t)sys_clock_hw_cycles_per_sec())
+#endif
+
+#endif
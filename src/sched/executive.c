@@ -0,0 +1,308 @@
+/**
+ * @file executive.c
+ * @brief Timer-driven periodic executive.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "executive.h"
+#include "opmode.h"
+#include "cycles.h"
+#include "../sensors/events.h"
+#include "../diag/trace.h"
+#include "../config/persist.h"
+
+/* Registered tasks, kept sorted by priority */
+static struct exec_task_t *exec_tasks[EXEC_MAX_TASKS];
+static int exec_n_tasks = 0;
+
+/* Protects the runtime fields of the tasks against concurrent readers */
+static struct k_spinlock exec_lock;
+
+K_THREAD_STACK_DEFINE(exec_thread_stack, EXEC_STACK_SIZE);
+struct k_thread exec_thread_data;
+k_tid_t exec_thread_tid;
+
+/* Wakes up the executive thread at the earliest pending release */
+static struct k_timer exec_timer;
+static K_SEM_DEFINE(exec_sem, 0, 1);
+
+static void exec_timer_expiry(struct k_timer *timer) {
+    opmode_wake(WAKE_SRC_TIMER);
+    k_sem_give(&exec_sem);
+}
+
+int exec_register(struct exec_task_t *task) {
+
+    if(exec_n_tasks == EXEC_MAX_TASKS) {
+        return -ENOMEM;
+    }
+    if(task->period_ms == 0) {
+        return -EINVAL;
+    }
+
+    /* Insert sorted by priority, tasks with the same priority keep registration order */
+    int i = exec_n_tasks;
+    while(i > 0 && exec_tasks[i - 1]->prio > task->prio) {
+        exec_tasks[i] = exec_tasks[i - 1];
+        i--;
+    }
+    exec_tasks[i] = task;
+    exec_n_tasks++;
+
+    /* Until exec_start(), exec_set_periodic() and exec_trigger() only record their request */
+    task->periodic = 1;
+    task->trigger_time = INT64_MAX;
+
+    return 0;
+}
+
+/* Earliest pending release of a task, periodic or event. Called with exec_lock held. */
+static inline int64_t exec_task_release(const struct exec_task_t *task) {
+    return MIN(task->next_release, task->trigger_time);
+}
+
+/* Returns the highest priority task whose release instant has been reached, or NULL */
+static struct exec_task_t *exec_next_ready(int64_t now) {
+    struct exec_task_t *ready = NULL;
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    for(int i = 0; i < exec_n_tasks; i++) {
+        if(exec_task_release(exec_tasks[i]) <= now) {
+            ready = exec_tasks[i];
+            break;
+        }
+    }
+    k_spin_unlock(&exec_lock, key);
+    return ready;
+}
+
+/* Runs one job of a task and updates its statistics */
+static void exec_run_job(struct exec_task_t *task) {
+
+    cycles_stamp_t start_time, end_time;
+    int64_t start = k_uptime_ticks();
+
+    /* A single job serves both a periodic release and a pending event */
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    int64_t release = exec_task_release(task);
+    int periodic_release = (task->next_release <= start);
+    if(task->trigger_time <= start) {
+        task->trigger_time = INT64_MAX;
+    }
+    if(periodic_release && !task->periodic) {
+        /* One-shot release requested with exec_trigger_at(), the job may request another one */
+        task->next_release = INT64_MAX;
+    }
+    k_spin_unlock(&exec_lock, key);
+
+    TRACE(TRACE_EVT_TASK_BEGIN, task->id);
+    start_time = cycles_now();
+    task->run();
+    end_time = cycles_now();
+    TRACE(TRACE_EVT_TASK_END, task->id);
+
+    int64_t end = k_uptime_ticks();
+
+    uint32_t jitter_us = (uint32_t)k_ticks_to_us_floor64(start - release);
+    uint32_t response_us = (uint32_t)k_ticks_to_us_floor64(end - release);
+    uint32_t exec_ns = (uint32_t)cycles_to_ns(start_time, end_time);
+
+    key = k_spin_lock(&exec_lock);
+    task->stats.activations++;
+    stats_add(&task->stats.exec_ns, exec_ns);
+    stats_hist_add(&task->stats.exec_hist_us, exec_ns / 1000);
+    stats_add(&task->stats.jitter_us, jitter_us);
+    stats_add(&task->stats.response_us, response_us);
+
+    /* Deadline check */
+    uint32_t deadline_ms = task->deadline_ms ? task->deadline_ms : task->period_ms;
+    int missed = (end - release) > (int64_t)k_ms_to_ticks_ceil64(deadline_ms);
+    if(missed) {
+        task->stats.deadline_misses++;
+        task->stats.last_miss_ms = k_uptime_get_32();
+    }
+
+    /* Next release is anchored to the previous one, not to the current time.
+       Event releases do not move the periodic schedule. */
+    if(periodic_release && task->periodic) {
+        int64_t prev = task->next_release;
+        int64_t next = prev + task->period_ticks;
+        if(next <= end && task->policy == EXEC_POLICY_SKIP) {
+            /* Overran past the next release(s), resume at the next period boundary */
+            int64_t lost = (end - prev) / task->period_ticks;
+            next = prev + (lost + 1) * task->period_ticks;
+            task->stats.skipped += lost;
+        }
+        task->next_release = next;
+    }
+    k_spin_unlock(&exec_lock, key);
+
+    if(missed) {
+        events_push(EVT_SRC_TASK, task->id, EVT_DEADLINE_MISS);
+    }
+}
+
+static void exec_thread_code(void *argA, void *argB, void *argC) {
+
+    struct exec_task_t *task;
+
+    while(true) {
+        k_sem_take(&exec_sem, K_FOREVER);
+
+        /* Run every released job, re-checking after each one so that a higher
+           priority task released in the meantime goes first */
+        while((task = exec_next_ready(k_uptime_ticks())) != NULL) {
+            exec_run_job(task);
+        }
+
+        /* Sleep until the earliest pending release, or until an event arrives */
+        int64_t earliest = INT64_MAX;
+        k_spinlock_key_t key = k_spin_lock(&exec_lock);
+        for(int i = 0; i < exec_n_tasks; i++) {
+            earliest = MIN(earliest, exec_task_release(exec_tasks[i]));
+        }
+        k_spin_unlock(&exec_lock, key);
+        if(earliest != INT64_MAX) {
+            k_timer_start(&exec_timer, K_TIMEOUT_ABS_TICKS(earliest), K_NO_WAIT);
+        } else {
+            k_timer_stop(&exec_timer);
+        }
+    }
+}
+
+void exec_start(void) {
+
+    int64_t start = k_uptime_ticks();
+
+    for(int i = 0; i < exec_n_tasks; i++) {
+        struct exec_task_t *task = exec_tasks[i];
+        exec_stats_reset(i);
+        task->period_ticks = k_ms_to_ticks_ceil32(task->period_ms);
+        /* Tasks made event-driven before the start (restored mode) only run on triggers */
+        task->next_release = task->periodic ? start + k_ms_to_ticks_ceil64(task->phase_ms) : INT64_MAX;
+    }
+
+    cycles_init();
+
+    k_timer_init(&exec_timer, exec_timer_expiry, NULL);
+
+    exec_thread_tid = k_thread_create(&exec_thread_data, exec_thread_stack,
+        K_THREAD_STACK_SIZEOF(exec_thread_stack), exec_thread_code,
+        NULL, NULL, NULL, EXEC_THREAD_PRIO, 0, K_NO_WAIT);
+    k_thread_name_set(exec_thread_tid, "executive");
+
+    /* First pass, arms the timer */
+    k_sem_give(&exec_sem);
+}
+
+int exec_set_period(int idx, uint32_t period_ms) {
+
+    if(period_ms < EXEC_PERIOD_MIN_MS || period_ms > EXEC_PERIOD_MAX_MS) {
+        return -EINVAL;
+    }
+
+    /* Picked up by exec_run_job() when computing the release after the pending one */
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    exec_tasks[idx]->period_ms = period_ms;
+    exec_tasks[idx]->period_ticks = k_ms_to_ticks_ceil32(period_ms);
+    k_spin_unlock(&exec_lock, key);
+
+    persist_touch(PERSIST_TASKS);
+
+    return 0;
+}
+
+void exec_set_periodic(struct exec_task_t *task, bool periodic) {
+
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    task->periodic = periodic;
+    /* Periodic releases restart one period from now */
+    task->next_release = periodic ? k_uptime_ticks() + task->period_ticks : INT64_MAX;
+    k_spin_unlock(&exec_lock, key);
+
+    k_sem_give(&exec_sem);
+}
+
+void exec_trigger(struct exec_task_t *task) {
+
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    if(task->trigger_time == INT64_MAX) {
+        task->trigger_time = k_uptime_ticks();
+    }
+    k_spin_unlock(&exec_lock, key);
+
+    k_sem_give(&exec_sem);
+}
+
+void exec_trigger_at(struct exec_task_t *task, int64_t uptime_ms) {
+
+    int64_t release = k_ms_to_ticks_ceil64(uptime_ms);
+
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    if(!task->periodic) {
+        task->next_release = MIN(task->next_release, release);
+    }
+    k_spin_unlock(&exec_lock, key);
+
+    /* Let the executive re-arm its timer */
+    k_sem_give(&exec_sem);
+}
+
+int exec_set_deadline(int idx, uint32_t deadline_ms, uint8_t policy) {
+
+    if(deadline_ms > EXEC_PERIOD_MAX_MS ||
+       (policy != EXEC_POLICY_SKIP && policy != EXEC_POLICY_CATCHUP)) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    exec_tasks[idx]->deadline_ms = deadline_ms;
+    exec_tasks[idx]->policy = policy;
+    k_spin_unlock(&exec_lock, key);
+
+    persist_touch(PERSIST_TASKS);
+
+    return 0;
+}
+
+void exec_stats_get(int idx, struct exec_stats_t *stats) {
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    *stats = exec_tasks[idx]->stats;
+    k_spin_unlock(&exec_lock, key);
+}
+
+void exec_stats_reset(int idx) {
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    struct exec_stats_t *stats = &exec_tasks[idx]->stats;
+    stats->activations = 0;
+    stats_reset(&stats->exec_ns);
+    stats_hist_reset(&stats->exec_hist_us);
+    stats_reset(&stats->jitter_us);
+    stats_reset(&stats->response_us);
+    stats->deadline_misses = 0;
+    stats->last_miss_ms = 0;
+    stats->skipped = 0;
+    k_spin_unlock(&exec_lock, key);
+}
+
+int exec_task_count(void) {
+    return exec_n_tasks;
+}
+
+int exec_task_find(char id) {
+    for(int i = 0; i < exec_n_tasks; i++) {
+        if(exec_tasks[i]->id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void exec_task_get(int idx, struct exec_task_t *task) {
+    k_spinlock_key_t key = k_spin_lock(&exec_lock);
+    *task = *exec_tasks[idx];
+    k_spin_unlock(&exec_lock, key);
+}
@@ -0,0 +1,219 @@
+/**
+ * @file executive.h
+ * @brief Timer-driven periodic executive.
+ *
+ * This header file declares a small periodic executive that runs registered
+ * tasks from a single thread. Releases are kept at absolute tick deadlines
+ * (release(k) = start + phase + k * period), so the schedule does not drift,
+ * and the executive thread is woken by a k_timer programmed for the earliest
+ * pending release.
+ *
+ * Tasks released at the same time run in priority order (lower value first)
+ * and each task runs to completion. For every task the executive records the
+ * execution time (measured with the timing API, or the kernel cycle counter
+ * on targets without it), the release jitter and the
+ * response time of each job (see exec_stats_t).
+ *
+ * A job that ends after its relative deadline is counted as a miss and raises
+ * an EVT_DEADLINE_MISS event in the event log. When a job overruns past the
+ * following releases, the task's policy either drops them (skip) or runs
+ * them back to back (catch-up).
+ *
+ * Besides their periodic releases, tasks can be released by events (e.g. an
+ * interrupt) with exec_trigger(). A task with its periodic releases disabled
+ * only runs on events, so the executive thread sleeps until one arrives.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __EXECUTIVE_H__
+#define __EXECUTIVE_H__
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>   /* for timing services */
+#include "stats.h"
+#include <stdint.h>
+
+#define EXEC_MAX_TASKS 8            /* Max number of registered tasks */
+#define EXEC_STACK_SIZE 1024        /* Stack of the executive thread, shared by all tasks */
+#define EXEC_THREAD_PRIO 1          /* Priority of the executive thread */
+#define EXEC_PERIOD_MIN_MS 10       /* Shortest period accepted at runtime */
+#define EXEC_PERIOD_MAX_MS 60000    /* Longest period accepted at runtime */
+
+/* Overrun policies, applied when a job ends after the next release of its task */
+#define EXEC_POLICY_SKIP 0      /* Drop the missed releases and resume at the next period boundary */
+#define EXEC_POLICY_CATCHUP 1   /* Run the missed releases back to back */
+
+/**
+ * @struct exec_stats_t
+ *
+ * @brief Timing statistics of a task.
+ *
+ * Release jitter is the delay from the release instant to the job start,
+ * response time is the delay from the release instant to the job end.
+ */
+struct exec_stats_t {
+    uint32_t activations;           /* Number of jobs run */
+    struct stat_acc_t exec_ns;      /* Execution time */
+    struct stat_hist_t exec_hist_us;
+    struct stat_acc_t jitter_us;    /* Release jitter */
+    struct stat_acc_t response_us;  /* Response time */
+    uint32_t deadline_misses;       /* Jobs that ended after their deadline */
+    uint32_t last_miss_ms;          /* Uptime of the last deadline miss */
+    uint32_t skipped;               /* Releases dropped by EXEC_POLICY_SKIP */
+};
+
+/**
+ * @struct exec_task_t
+ *
+ * @brief Periodic task descriptor.
+ *
+ * The first block is filled by the owner of the task before registering it,
+ * the remaining fields are managed by the executive.
+ */
+struct exec_task_t {
+    const char *name;           /* Name used in reports */
+    char id;                    /* One-letter ID used by UART commands */
+    void (*run)(void);          /* Job body, must not block */
+    uint32_t period_ms;         /* Period */
+    uint32_t phase_ms;          /* Offset of the first release from the executive start */
+    uint8_t prio;               /* Lower value runs first when released together */
+    uint32_t deadline_ms;       /* Relative deadline, 0 means equal to the period */
+    uint8_t policy;             /* Overrun policy (EXEC_POLICY_*) */
+
+    /* Managed by the executive */
+    int64_t next_release;       /* Next periodic release (absolute, in ticks), INT64_MAX if none */
+    int64_t trigger_time;       /* Instant of the pending event release, INT64_MAX if none */
+    uint8_t periodic;           /* 0 when the task only runs on events (see exec_set_periodic()) */
+    uint32_t period_ticks;
+    struct exec_stats_t stats;
+};
+
+/**
+ * @brief Registers a task with the executive.
+ *
+ * Tasks must be registered before exec_start() is called.
+ *
+ * @param task Task descriptor, must outlive the executive.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -ENOMEM if EXEC_MAX_TASKS tasks are already registered.
+ * - Returns -EINVAL if the period is zero.
+ */
+int exec_register(struct exec_task_t *task);
+
+/**
+ * @brief Starts the executive thread.
+ *
+ * The first release of each task happens phase_ms after this call. Tasks
+ * made event-driven (exec_set_periodic()) before the call are not released
+ * periodically, and triggers requested before it run at the start, so the
+ * operating mode can be restored before the tasks start.
+ */
+void exec_start(void);
+
+/**
+ * @brief Changes the period of a task at runtime.
+ *
+ * The release already scheduled keeps its instant, the new period applies to
+ * the releases that follow it. The schedule stays anchored to the last
+ * release, so there is no phase jump and no burst of releases.
+ *
+ * @param idx Index of the task (0 to exec_task_count()-1).
+ * @param period_ms New period (EXEC_PERIOD_MIN_MS to EXEC_PERIOD_MAX_MS).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if the period is out of bounds.
+ */
+int exec_set_period(int idx, uint32_t period_ms);
+
+/**
+ * @brief Enables or disables the periodic releases of a task.
+ *
+ * When enabled again, the first periodic release happens one period from now.
+ *
+ * @param task Task descriptor.
+ * @param periodic true to release the task periodically, false to release it only on events.
+ */
+void exec_set_periodic(struct exec_task_t *task, bool periodic);
+
+/**
+ * @brief Releases a task now.
+ *
+ * Can be called from ISR context. Several triggers before the job starts are
+ * served by a single job. Does not change the periodic schedule of the task.
+ *
+ * @param task Task descriptor.
+ */
+void exec_trigger(struct exec_task_t *task);
+
+/**
+ * @brief Schedules a one-shot release of a task that is not periodic.
+ *
+ * Used by event-driven tasks that need to run again at a known instant
+ * (e.g. a timeout). Ignored while the task is periodic. If several instants
+ * are requested, the earliest one is kept.
+ *
+ * @param task Task descriptor.
+ * @param uptime_ms Release instant (uptime, in ms).
+ */
+void exec_trigger_at(struct exec_task_t *task, int64_t uptime_ms);
+
+/**
+ * @brief Changes the relative deadline and overrun policy of a task.
+ *
+ * @param idx Index of the task (0 to exec_task_count()-1).
+ * @param deadline_ms Relative deadline (1 to EXEC_PERIOD_MAX_MS), 0 to follow the period.
+ * @param policy Overrun policy (EXEC_POLICY_SKIP or EXEC_POLICY_CATCHUP).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if an argument is out of range.
+ */
+int exec_set_deadline(int idx, uint32_t deadline_ms, uint8_t policy);
+
+/**
+ * @brief Reads a consistent snapshot of the statistics of a task.
+ *
+ * @param idx Index of the task (0 to exec_task_count()-1).
+ * @param stats Pointer to store the statistics.
+ */
+void exec_stats_get(int idx, struct exec_stats_t *stats);
+
+/**
+ * @brief Clears the statistics of a task.
+ *
+ * @param idx Index of the task (0 to exec_task_count()-1).
+ */
+void exec_stats_reset(int idx);
+
+/**
+ * @brief Returns the number of registered tasks.
+ *
+ * @return int Number of tasks.
+ */
+int exec_task_count(void);
+
+/**
+ * @brief Finds a registered task by its one-letter ID.
+ *
+ * @param id Task ID.
+ *
+ * @return int Index of the task, or -1 if there is no such task.
+ */
+int exec_task_find(char id);
+
+/**
+ * @brief Reads a consistent snapshot of a task and its statistics.
+ *
+ * @param idx Index of the task (0 to exec_task_count()-1).
+ * @param task Pointer to store the snapshot.
+ */
+void exec_task_get(int idx, struct exec_task_t *task);
+
+#endif
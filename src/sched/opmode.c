@@ -0,0 +1,58 @@
+/**
+ * @file opmode.c
+ * @brief Operating mode (periodic polling or event-driven) and wakeup accounting.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "opmode.h"
+#include "../config/persist.h"
+
+static opmode_listener_t opmode_listeners[OPMODE_MAX_LISTENERS];
+static int opmode_n_listeners = 0;
+static int opmode_current = OPMODE_PERIODIC;
+static atomic_t wake_count[WAKE_SRC_COUNT];
+
+K_MUTEX_DEFINE(opmode_mutex);
+
+int opmode_register(opmode_listener_t listener) {
+    if(opmode_n_listeners == OPMODE_MAX_LISTENERS) {
+        return -ENOMEM;
+    }
+    opmode_listeners[opmode_n_listeners++] = listener;
+    return 0;
+}
+
+int opmode_set(int mode) {
+
+    if(mode != OPMODE_PERIODIC && mode != OPMODE_EVENT) {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&opmode_mutex, K_FOREVER);
+    if(mode != opmode_current) {
+        opmode_current = mode;
+        for(int i = 0; i < opmode_n_listeners; i++) {
+            opmode_listeners[i](mode);
+        }
+        persist_touch(PERSIST_MODE);
+    }
+    k_mutex_unlock(&opmode_mutex);
+
+    return 0;
+}
+
+int opmode_get(void) {
+    return opmode_current;
+}
+
+void opmode_wake(int src) {
+    atomic_inc(&wake_count[src]);
+}
+
+uint32_t opmode_wakeups(int src) {
+    return atomic_get(&wake_count[src]);
+}
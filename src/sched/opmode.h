@@ -0,0 +1,91 @@
+/**
+ * @file opmode.h
+ * @brief Operating mode (periodic polling or event-driven) and wakeup accounting.
+ *
+ * In the periodic mode every task is released by the executive at its period.
+ * In the event-driven mode the system sleeps until something happens: a UART
+ * frame, a button edge, an ADC conversion completing or the period of a task
+ * the host subscribed to. Tasks that only mirror state (buttons, LEDs) are
+ * then released by their events instead of polling.
+ *
+ * Every wakeup is counted per source, in both modes, so the savings of the
+ * event-driven mode can be verified.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __OPMODE_H__
+#define __OPMODE_H__
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+/* Operating modes */
+#define OPMODE_PERIODIC 0
+#define OPMODE_EVENT 1
+
+/* Wakeup sources */
+#define WAKE_SRC_UART 0     /* UART data received */
+#define WAKE_SRC_GPIO 1     /* Button edge */
+#define WAKE_SRC_ADC 2      /* ADC conversion completed */
+#define WAKE_SRC_TIMER 3    /* Periodic release of a task */
+#define WAKE_SRC_COUNT 4
+
+#define OPMODE_MAX_LISTENERS 4
+
+/**
+ * @brief Callback invoked when the operating mode changes.
+ *
+ * @param mode New mode (OPMODE_*).
+ */
+typedef void (*opmode_listener_t)(int mode);
+
+/**
+ * @brief Registers a callback invoked on every mode change.
+ *
+ * @param listener Callback.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -ENOMEM if OPMODE_MAX_LISTENERS callbacks are already registered.
+ */
+int opmode_register(opmode_listener_t listener);
+
+/**
+ * @brief Changes the operating mode.
+ *
+ * @param mode New mode (OPMODE_PERIODIC or OPMODE_EVENT).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if the mode is unknown.
+ */
+int opmode_set(int mode);
+
+/**
+ * @brief Returns the current operating mode.
+ *
+ * @return int Current mode (OPMODE_*).
+ */
+int opmode_get(void);
+
+/**
+ * @brief Counts a wakeup. Can be called from ISR context.
+ *
+ * @param src Wakeup source (WAKE_SRC_*).
+ */
+void opmode_wake(int src);
+
+/**
+ * @brief Returns the number of wakeups of a source since boot.
+ *
+ * @param src Wakeup source (WAKE_SRC_*).
+ *
+ * @return uint32_t Number of wakeups.
+ */
+uint32_t opmode_wakeups(int src);
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * @file stats.c
+ * @brief Running statistics and log2 histograms for timing measurements.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "stats.h"
+#include <string.h>
+
+void stats_reset(struct stat_acc_t *acc) {
+    acc->count = 0;
+    acc->min = UINT32_MAX;
+    acc->max = 0;
+    acc->sum = 0;
+}
+
+void stats_add(struct stat_acc_t *acc, uint32_t value) {
+    acc->count++;
+    acc->sum += value;
+    if(value < acc->min) {
+        acc->min = value;
+    }
+    if(value > acc->max) {
+        acc->max = value;
+    }
+}
+
+uint32_t stats_mean(const struct stat_acc_t *acc) {
+    return acc->count ? (uint32_t)(acc->sum / acc->count) : 0;
+}
+
+void stats_hist_reset(struct stat_hist_t *hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+void stats_hist_add(struct stat_hist_t *hist, uint32_t value) {
+    /* find_msb_set() is 0 for 0 and k for values in [2^(k-1), 2^k) */
+    int bucket = find_msb_set(value);
+    if(bucket >= STATS_HIST_BUCKETS) {
+        bucket = STATS_HIST_BUCKETS - 1;
+    }
+    hist->bucket[bucket]++;
+}
+
+uint32_t stats_hist_bucket_min(int bucket) {
+    return bucket ? BIT(bucket - 1) : 0;
+}
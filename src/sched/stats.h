@@ -0,0 +1,92 @@
+/**
+ * @file stats.h
+ * @brief Running statistics and log2 histograms for timing measurements.
+ *
+ * This header file declares small accumulators (count, min, max, sum) and
+ * histograms with power-of-two buckets. Adding a sample costs a few integer
+ * operations, so they can stay enabled on every job or command.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+#define STATS_HIST_BUCKETS 16   /* Bucket 0 holds 0, bucket k holds [2^(k-1), 2^k), the last one is open */
+
+/**
+ * @struct stat_acc_t
+ *
+ * @brief Running min/max/mean accumulator.
+ */
+struct stat_acc_t {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+};
+
+/**
+ * @struct stat_hist_t
+ *
+ * @brief Histogram with power-of-two buckets.
+ */
+struct stat_hist_t {
+    uint32_t bucket[STATS_HIST_BUCKETS];
+};
+
+/**
+ * @brief Clears an accumulator.
+ *
+ * @param acc Accumulator to clear.
+ */
+void stats_reset(struct stat_acc_t *acc);
+
+/**
+ * @brief Adds a sample to an accumulator.
+ *
+ * @param acc Accumulator.
+ * @param value Sample.
+ */
+void stats_add(struct stat_acc_t *acc, uint32_t value);
+
+/**
+ * @brief Returns the mean of the samples of an accumulator.
+ *
+ * @param acc Accumulator.
+ *
+ * @return uint32_t Mean, or 0 if there are no samples.
+ */
+uint32_t stats_mean(const struct stat_acc_t *acc);
+
+/**
+ * @brief Clears a histogram.
+ *
+ * @param hist Histogram to clear.
+ */
+void stats_hist_reset(struct stat_hist_t *hist);
+
+/**
+ * @brief Adds a sample to a histogram.
+ *
+ * @param hist Histogram.
+ * @param value Sample.
+ */
+void stats_hist_add(struct stat_hist_t *hist, uint32_t value);
+
+/**
+ * @brief Returns the lower bound of a histogram bucket.
+ *
+ * @param bucket Bucket index (0 to STATS_HIST_BUCKETS-1).
+ *
+ * @return uint32_t Smallest value counted in the bucket.
+ */
+uint32_t stats_hist_bucket_min(int bucket);
+
+#endif
@@ -1,25 +1,44 @@
 
 #include "adc.h"
+#include "opmode.h"
+#include "replay.h"
+#include "rules.h"
+#include <zephyr/logging/log.h>
 
+LOG_MODULE_REGISTER(app_adc, CONFIG_APP_ADC_LOG_LEVEL);
 
 const struct device *adc_dev = DEVICE_DT_GET(ADC_NODE);	
 
-/* ADC channel configuration */
-static const struct adc_channel_cfg my_channel_cfg = {
-	.gain = ADC_GAIN,
-	.reference = ADC_REFERENCE,
-	.acquisition_time = ADC_ACQUISITION_TIME,
-	.channel_id = ADC_CHANNEL_ID,
-	.input_positive = ADC_CHANNEL_INPUT
-};
-
 /* Global vars */
 struct k_timer my_timer;
 static uint16_t adc_sample_buffer[BUFFER_SIZE];
 
-K_THREAD_STACK_DEFINE(thread_ADC_stack, STACK_SIZE);
-struct k_thread thread_ADC_data;
-k_tid_t thread_ADC_tid;
+/* Serializes the start of conversions by the ADC task and by the stream */
+static K_MUTEX_DEFINE(adc_lock);
+
+/* Stream: conversions repeated by the driver every interval_us */
+static uint16_t adc_stream_buffer[BUFFER_SIZE];
+static atomic_t adc_stream_on = ATOMIC_INIT(0);
+static atomic_t adc_stream_last;
+static adc_stream_cb_t adc_stream_cb;
+
+static struct exec_task_t adc_task = {
+    .name = "adc",
+    .id = 'A',
+    .run = task_ADC_code,
+    .period_ms = thread_ADC_period,
+    .phase_ms = thread_ADC_phase,
+    .prio = thread_ADC_prio
+};
+
+/* Takes the latest streamed sample instead of converting, adc_lock must be held */
+static bool adc_stream_sample(void) {
+    if(!atomic_get(&adc_stream_on)) {
+        return false;
+    }
+    adc_sample_buffer[0] = (uint16_t)atomic_get(&adc_stream_last);
+    return true;
+}
 
 int adc_sample(void)
 {
@@ -32,89 +51,177 @@ int adc_sample(void)
 	};
 
 	if (adc_dev == NULL) {
-            printk("adc_sample(): error, must bind to adc first \n\r");
+            LOG_ERR("adc_sample(): error, must bind to adc first");
             return -1;
 	}
 
+	/* A replayed trace replaces the conversion */
+	if (replay_adc(&adc_sample_buffer[0])) {
+            return 0;
+	}
+
+	k_mutex_lock(&adc_lock, K_FOREVER);
+	if (adc_stream_sample()) {
+            k_mutex_unlock(&adc_lock);
+            return 0;
+	}
 	ret = adc_read(adc_dev, &sequence);
+	k_mutex_unlock(&adc_lock);
 	if (ret) {
-            printk("adc_read() failed with code %d\n", ret);
+            LOG_ERR("adc_read() failed with code %d", ret);
 	}	
 
 	return ret;
 }
 
-void thread_ADC_code(void *argA, void *argB, void *argC) {
+static enum adc_action adc_stream_done(const struct device *dev, const struct adc_sequence *sequence,
+                                       uint16_t sampling_index) {
+    atomic_set(&adc_stream_last, adc_stream_buffer[0]);
+    if(adc_stream_cb(adc_stream_buffer[0])) {
+        /* Same buffer again, next conversion when the driver interval timer expires */
+        return ADC_ACTION_REPEAT;
+    }
+    atomic_set(&adc_stream_on, 0);
+    return ADC_ACTION_FINISH;
+}
 
-    timing_t fin_time=0, release_time=0;
-    
-    /* Variables to time execution */
-    timing_t start_time, end_time;
-    uint64_t total_cycles=0;
-    uint64_t total_ns=0;
+static struct adc_sequence_options adc_stream_options = {
+    .callback = adc_stream_done,
+};
 
-    /* Compute next release instant */
-    release_time = k_uptime_get() + thread_ADC_period;
+static const struct adc_sequence adc_stream_sequence = {
+    .options = &adc_stream_options,
+    .channels = BIT(ADC_CHANNEL_ID),
+    .buffer = adc_stream_buffer,
+    .buffer_size = sizeof(adc_stream_buffer),
+    .resolution = ADC_RESOLUTION,
+};
 
-    int err = 0;
-    while(true){
-        /* Get one sample, checks for errors and prints the values */
-	start_time = timing_counter_get(); 
+int adc_stream_start(uint32_t interval_us, adc_stream_cb_t cb) {
 
-        err=adc_sample();
-        if(err) {
-            printk("adc_sample() failed with error code %d\n\r",err);
-        }
-        else {
-            if(adc_sample_buffer[0] > 1023) {
-                printk("adc reading out of range (value is %u)\n\r", adc_sample_buffer[0]);
-            }
-            else {
-                /* ADC is set to use gain of 1/4 and reference VDD/4, so input range is 0...VDD (3 V), with 10 bit resolution */
-                //printk("adc reading: raw:%4u / %4u mV: \n\r",adc_sample_buffer[0],(uint16_t)(1000*adc_sample_buffer[0]*((float)3/1023)));
-                //printk("The AN value is: %4u", 60 * 1000*adc_sample_buffer[0]*((float)3/1023)- 60);
-		rtdb_set_adc_raw(adc_sample_buffer[0]);
-		rtdb_set_adc_an((int) (1000*adc_sample_buffer[0] * ((float)3/1023)));
-		//ESCREVE NOS DADOS
-            }
-        }
-        end_time = timing_counter_get();
+    k_mutex_lock(&adc_lock, K_FOREVER);
+    if(atomic_get(&adc_stream_on)) {
+        k_mutex_unlock(&adc_lock);
+        return -EBUSY;
+    }
 
-        total_cycles = timing_cycles_get(&start_time, &end_time);
-        total_ns = timing_cycles_to_ns(total_cycles);
-       
-        /* Wait for next release instant */ 
-        fin_time = k_uptime_get();
-        if( fin_time < release_time) {
-            k_msleep(release_time - fin_time); /* There are other variants, k_sleep(), k_usleep(), ... */       
+    adc_stream_cb = cb;
+    adc_stream_options.interval_us = interval_us;
+    atomic_set(&adc_stream_last, adc_sample_buffer[0]);
+    atomic_set(&adc_stream_on, 1);
 
-        }
+    /* Waits for a conversion of the ADC task still in progress, if any */
+    int err = adc_read_async(adc_dev, &adc_stream_sequence, NULL);
+    if(err) {
+        LOG_ERR("adc_read_async() failed with error code %d", err);
+        atomic_set(&adc_stream_on, 0);
+    }
+    k_mutex_unlock(&adc_lock);
+    return err;
+}
 
-        /* Update next release time instant*/
-        release_time += thread_ADC_period;
+bool adc_streaming(void) {
+    return atomic_get(&adc_stream_on);
+}
 
-        //k_msleep(TIMER_INTERVAL_MSEC);
+/* Event-driven mode: conversions run asynchronously and their completion releases the task */
+#define ADC_ASYNC_IDLE 0
+#define ADC_ASYNC_BUSY 1
+#define ADC_ASYNC_DONE 2
+static atomic_t adc_async_state = ATOMIC_INIT(ADC_ASYNC_IDLE);
+
+static enum adc_action adc_async_done(const struct device *dev, const struct adc_sequence *sequence,
+                                      uint16_t sampling_index) {
+    atomic_set(&adc_async_state, ADC_ASYNC_DONE);
+    opmode_wake(WAKE_SRC_ADC);
+    exec_trigger(&adc_task);
+    return ADC_ACTION_FINISH;
+}
+
+static const struct adc_sequence_options adc_async_options = {
+    .callback = adc_async_done,
+};
+
+static const struct adc_sequence adc_async_sequence = {
+    .options = &adc_async_options,
+    .channels = BIT(ADC_CHANNEL_ID),
+    .buffer = adc_sample_buffer,
+    .buffer_size = sizeof(adc_sample_buffer),
+    .resolution = ADC_RESOLUTION,
+};
+
+int adc_raw_to_mv(int raw) {
+    /* ADC is set to use gain of 1/4 and reference VDD/4, so input range is 0...VDD (3 V), with 10 bit resolution */
+    return (int) (1000*raw * ((float)3/1023));
+}
+
+/* Checks the sample in the buffer and stores it in the RTDB */
+static void adc_store_sample(void) {
+    if(adc_sample_buffer[0] > 1023) {
+        LOG_WRN("adc reading out of range (value is %u)", adc_sample_buffer[0]);
+    }
+    else {
+        replay_record(REPLAY_ADC, adc_sample_buffer[0]);
+        rtdb_set_adc_raw(adc_sample_buffer[0]);
+        rtdb_set_adc_an(adc_raw_to_mv(adc_sample_buffer[0]));
+        rules_adc(adc_sample_buffer[0]);
+    }
+}
+
+void task_ADC_code(void) {
+
+    if(opmode_get() == OPMODE_EVENT) {
+        /* Released either by the subscribed period (start a conversion) or by its completion (store it) */
+        if(atomic_cas(&adc_async_state, ADC_ASYNC_DONE, ADC_ASYNC_IDLE)) {
+            adc_store_sample();
+            return;
+        }
+        if(replay_adc(&adc_sample_buffer[0])) {
+            adc_store_sample();
+            return;
+        }
+        k_mutex_lock(&adc_lock, K_FOREVER);
+        if(adc_stream_sample()) {
+            adc_store_sample();
+        } else if(atomic_cas(&adc_async_state, ADC_ASYNC_IDLE, ADC_ASYNC_BUSY)) {
+            int err = adc_read_async(adc_dev, &adc_async_sequence, NULL);
+            if(err) {
+                LOG_ERR("adc_read_async() failed with error code %d", err);
+                atomic_set(&adc_async_state, ADC_ASYNC_IDLE);
+            }
+        }
+        k_mutex_unlock(&adc_lock);
+        return;
     }
-    timing_stop();
 
+    /* Get one sample, checks for errors and stores the values */
+    int err=adc_sample();
+    if(err) {
+        LOG_ERR("adc_sample() failed with error code %d",err);
+    }
+    else {
+        adc_store_sample();
+    }
 }
 
 int configure_adc(void) {
 
    int err = 0;
 
-    err = adc_channel_setup(adc_dev, &my_channel_cfg);
+    /* Channel setup and calibration are target specific */
+    err = adc_hal_setup(adc_dev, ADC_CHANNEL_ID);
+    if (err) {
+        LOG_ERR("adc_hal_setup() failed with error code %d", err);
+        return ERR_CONFIG;
+    }
+
+    /* Periodic sampling is run by the executive */
+    err = exec_register(&adc_task);
     if (err) {
-        printk("adc_channel_setup() failed with error code %d\n", err);
+        LOG_ERR("exec_register() failed with error code %d", err);
         return ERR_CONFIG;
     }
-    NRF_SAADC->TASKS_CALIBRATEOFFSET = 1;
-        /* Main loop */
-    thread_ADC_tid = k_thread_create(&thread_ADC_data, thread_ADC_stack,
-        K_THREAD_STACK_SIZEOF(thread_ADC_stack), thread_ADC_code,
-        NULL, NULL, NULL, thread_ADC_prio, 0, K_NO_WAIT);
 
-    /* Should never reach this place ...*/
     return ERR_OK;
 }
 
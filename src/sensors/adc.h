@@ -19,6 +19,8 @@
 #define __ADC_H__
 
 #include "commons.h"
+#include "executive.h"
+#include "adc_hal.h"
 
 
 /*
@@ -26,19 +28,13 @@
  * */
 
 #define ADC_RESOLUTION 10
-#define ADC_GAIN ADC_GAIN_1_4
-#define ADC_REFERENCE ADC_REF_VDD_1_4
-#define ADC_ACQUISITION_TIME ADC_ACQ_TIME(ADC_ACQ_TIME_MICROSECONDS, 40)
 #define ADC_CHANNEL_ID 1  
 
-/* This is the actual nRF ANx input to use. Note that a channel can be assigned to any ANx. In fact a channel can */
-/*    be assigned to two ANx, when differential reading is set (one ANx for the positive signal and the other one for the negative signal) */  
-/* Note also that the configuration of different channels is completely independent (gain, resolution, ref voltage, ...) */
-#define ADC_CHANNEL_INPUT NRF_SAADC_INPUT_AIN1 
+/* Gain, reference, input and calibration depend on the target, see adc_hal.h */
 
 #define BUFFER_SIZE 1
 
-#define ADC_NODE DT_NODELABEL(adc)  
+#define ADC_NODE ADC_HAL_NODE
 
 /* Other defines */
 #define TIMER_INTERVAL_MSEC 1000 /* Interval between ADC samples */
@@ -48,14 +44,13 @@
 #define ERR_CONFIG -1   // Fail at set-up
 
 /* 
- * Thread defines
+ * Task defines
  *
  * */
 
-#define STACK_SIZE 1024
 #define thread_ADC_prio 2 
-#define thread_ADC_period 1000
-//K_TIMER_DEFINE(thread_ADC_timer, NULL, NULL);
+#define thread_ADC_period 1000   /* Default, can be changed at runtime (see exec_set_period()) */
+#define thread_ADC_phase 5      /* Released after the buttons */
 
 /**
  * @brief Sample the ADC and store the result in the buffer.
@@ -70,41 +65,88 @@
  * - Returns -1 if the ADC device is not bound.
  * - Returns a negative error code if the ADC read operation fails.
  *
- * @warning This function prints error messages to the console in case of failure.
+ * @note Failures are logged through the app_adc log module (CONFIG_APP_ADC_LOG_LEVEL),
+ *       deferred and kept off the protocol UART.
  */
 int adc_sample(void);
 
 /**
- * @brief Configure the ADC device and setup the ADC sampling thread.
+ * @brief Callback receiving the samples of a stream (see adc_stream_start()).
+ *
+ * Called from the ADC driver completion context (interrupt on the target).
+ *
+ * @param raw Raw sample (0-1023).
+ *
+ * @return bool True to keep sampling, false to end the stream.
+ */
+typedef bool (*adc_stream_cb_t)(uint16_t raw);
+
+/**
+ * @brief Start continuous sampling timed by the ADC driver.
+ *
+ * Every interval_us the channel is converted and the sample passed to cb,
+ * until cb returns false. While the stream runs, adc_sample() and the ADC
+ * task take the latest streamed sample instead of starting conversions of
+ * their own, so the RTDB keeps being updated.
+ *
+ * @param interval_us Sampling interval.
+ * @param cb Sample callback.
+ *
+ * @return int
+ * - Returns 0 if the stream started.
+ * - Returns -EBUSY if a stream is already running.
+ * - Returns a negative error code if the ADC read could not be started.
+ */
+int adc_stream_start(uint32_t interval_us, adc_stream_cb_t cb);
+
+/**
+ * @brief Check if a stream is running.
+ *
+ * @return bool True until the stream callback returns false.
+ */
+bool adc_streaming(void);
+
+/**
+ * @brief Convert a raw ADC sample to millivolts.
+ *
+ * The input range is 0 to 3000 mV over the 10-bit resolution on every
+ * target (see adc_hal.h).
+ *
+ * @param raw Raw sample (0-1023).
+ *
+ * @return int Input voltage in mV.
+ */
+int adc_raw_to_mv(int raw);
+
+/**
+ * @brief Configure the ADC device and register the ADC sampling task.
  *
  * This function sets up the ADC channel configuration, performs a calibration
- * of the ADC offset, and creates a thread for periodic ADC sampling.
+ * of the ADC offset, and registers the periodic ADC sampling task with the
+ * executive (see executive.h).
  *
  * @return int
  * - Returns ERR_OK (0) on successful configuration.
  * - Returns ERR_CONFIG (-1) if there is an error during ADC channel setup.
  *
- * @warning This function prints error messages to the console in case of failure.
+ * @note Failures are logged through the app_adc log module (CONFIG_APP_ADC_LOG_LEVEL),
+ *       deferred and kept off the protocol UART.
  */
 int configure_adc(void);
 
 /**
- * @brief ADC sampling thread function.
- *
- * This thread function periodically samples the ADC, processes the sampled data,
- * and stores the results in the real-time database (RTDB). It also measures the
- * execution time of the ADC sampling process.
+ * @brief ADC sampling task.
  *
- * @param argA Unused parameter.
- * @param argB Unused parameter.
- * @param argC Unused parameter.
+ * Run periodically by the executive, this job samples the ADC, processes the
+ * sampled data and stores the results in the real-time database (RTDB).
  *
  * The ADC is configured to use a gain of 1/4 and a reference voltage of VDD/4,
  * resulting in an input range of 0 to 3V with 10-bit resolution.
  *
- * @warning This function prints error messages to the console in case of failure.
- * @warning Ensure the thread periodicity (thread_ADC_period) is properly configured to avoid overrun or underrun.
+ * @note Failures are logged through the app_adc log module (CONFIG_APP_ADC_LOG_LEVEL),
+ *       deferred and kept off the protocol UART.
+ * @warning Ensure the task periodicity (thread_ADC_period) is properly configured to avoid overrun or underrun.
  */
-void thread_ADC_code(void *argA, void *argB, void *argC);
+void task_ADC_code(void);
 
 #endif 
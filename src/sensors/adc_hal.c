@@ -0,0 +1,53 @@
+/**
+ * @file adc_hal.c
+ * @brief Target-specific ADC configuration and calibration.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "adc_hal.h"
+
+#if defined(CONFIG_ADC_NRFX_SAADC)
+#include <hal/nrf_saadc.h>
+#endif
+
+#if defined(CONFIG_ADC_EMUL)
+#include <zephyr/drivers/adc/adc_emul.h>
+#endif
+
+int adc_hal_setup(const struct device *dev, uint8_t channel_id) {
+
+    const struct adc_channel_cfg channel_cfg = {
+        .gain = ADC_HAL_GAIN,
+        .reference = ADC_HAL_REFERENCE,
+        .acquisition_time = ADC_HAL_ACQUISITION_TIME,
+        .channel_id = channel_id,
+#if defined(CONFIG_ADC_CONFIGURABLE_INPUTS) && defined(ADC_HAL_INPUT)
+        .input_positive = ADC_HAL_INPUT
+#endif
+    };
+
+    int err = adc_channel_setup(dev, &channel_cfg);
+    if (err) {
+        return err;
+    }
+
+#if defined(CONFIG_ADC_NRFX_SAADC)
+    /* Offset calibration of the SAADC */
+    NRF_SAADC->TASKS_CALIBRATEOFFSET = 1;
+#endif
+
+#if defined(CONFIG_ADC_EMUL)
+    /* The emulator has no calibration, start with a mid-range input that can
+       be changed at runtime with adc_emul_const_value_set() */
+    err = adc_emul_const_value_set(dev, channel_id, ADC_HAL_EMUL_INPUT_MV);
+    if (err) {
+        return err;
+    }
+#endif
+
+    return 0;
+}
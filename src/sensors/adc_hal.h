@@ -0,0 +1,64 @@
+/**
+ * @file adc_hal.h
+ * @brief Target-specific ADC configuration and calibration.
+ *
+ * This header file isolates what differs between the nRF SAADC and the ADC
+ * emulator used on native_sim: the devicetree node, the channel setup (gain,
+ * reference, acquisition time, input) and the offset calibration. Both
+ * configurations give a 0 to 3000 mV input range, so the conversion done by
+ * the ADC task is the same on every target.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __ADC_HAL_H__
+#define __ADC_HAL_H__
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/adc.h>
+
+#if defined(CONFIG_ADC_NRFX_SAADC)
+
+#define ADC_HAL_NODE DT_NODELABEL(adc)
+
+/* Gain of 1/4 with reference VDD/4: input range is 0...VDD (3 V) */
+#define ADC_HAL_GAIN ADC_GAIN_1_4
+#define ADC_HAL_REFERENCE ADC_REF_VDD_1_4
+#define ADC_HAL_ACQUISITION_TIME ADC_ACQ_TIME(ADC_ACQ_TIME_MICROSECONDS, 40)
+
+/* This is the actual nRF ANx input to use. Note that a channel can be assigned to any ANx. In fact a channel can */
+/*    be assigned to two ANx, when differential reading is set (one ANx for the positive signal and the other one for the negative signal) */  
+/* Note also that the configuration of different channels is completely independent (gain, resolution, ref voltage, ...) */
+#define ADC_HAL_INPUT NRF_SAADC_INPUT_AIN1
+
+#else
+
+/* ADC emulator (native_sim): only unity gain is supported, the internal
+   reference is set to 3000 mV in the board overlay */
+#define ADC_HAL_NODE DT_NODELABEL(adc0)
+#define ADC_HAL_GAIN ADC_GAIN_1
+#define ADC_HAL_REFERENCE ADC_REF_INTERNAL
+#define ADC_HAL_ACQUISITION_TIME ADC_ACQ_TIME_DEFAULT
+
+#define ADC_HAL_EMUL_INPUT_MV 1500  /* Initial input of the emulated channel */
+
+#endif
+
+/**
+ * @brief Sets up an ADC channel for the target and calibrates the ADC.
+ *
+ * @param dev ADC device.
+ * @param channel_id Channel to set up.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns a negative error code if the channel could not be set up.
+ */
+int adc_hal_setup(const struct device *dev, uint8_t channel_id);
+
+#endif
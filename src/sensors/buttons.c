@@ -1,111 +1,96 @@
 
 #include "buttons.h"
+#include "gestures.h"
+#include "opmode.h"
+#include "capture.h"
+#include "replay.h"
+#include "rules.h"
+
+/* Buttons, in ID order, handled as a single GPIO bank */
+static const struct gpio_dt_spec but_pins[N_BUTTONS] = {
+    GPIO_DT_SPEC_GET(BUT0_NODE,gpios),
+    GPIO_DT_SPEC_GET(BUT1_NODE,gpios),
+    GPIO_DT_SPEC_GET(BUT2_NODE,gpios),
+    GPIO_DT_SPEC_GET(BUT3_NODE,gpios)
+};
+static struct gpio_bank_t but_bank;
 
-const struct gpio_dt_spec but_0 = GPIO_DT_SPEC_GET(BUT0_NODE,gpios);
-const struct gpio_dt_spec but_1 = GPIO_DT_SPEC_GET(BUT1_NODE,gpios);
-const struct gpio_dt_spec but_2 = GPIO_DT_SPEC_GET(BUT2_NODE,gpios);
-const struct gpio_dt_spec but_3 = GPIO_DT_SPEC_GET(BUT3_NODE,gpios);
-
-#define STACK_SIZE 1024
 #define thread_button_prio 1 /* Higher priority */     
-#define thread_button_period 1000
-K_THREAD_STACK_DEFINE(thread_button_stack, STACK_SIZE);
-struct k_thread thread_button_data;
-k_tid_t thread_button_tid;
-
-void thread_button_read_code(void *argA, void *argB, void *argC) {
-
-    timing_t fin_time=0, release_time=0;
-    
-    /* Variables to time execution */
-    timing_t start_time, end_time;
-    uint64_t total_cycles=0;
-    uint64_t total_ns=0;
-
-    /* Compute next release instant */
-    release_time = k_uptime_get() + thread_button_period;
-
-    while(true){
-        /* Get one sample, checks for errors and prints the values */
-        start_time = timing_counter_get(); 
-
-        int res = 0;
-            res = gpio_pin_get_dt(&but_0);    
-        rtdb_set_button(0, res);
-            res = gpio_pin_get_dt(&but_1);    
-        rtdb_set_button(1, res);
-            res = gpio_pin_get_dt(&but_2);    
-        rtdb_set_button(2, res);
-            res = gpio_pin_get_dt(&but_3);    
-        rtdb_set_button(3, res);
-
-
-        end_time = timing_counter_get();
+#define thread_button_period 20 /* Default, fast enough to resolve long-press/double-click gestures */
+#define thread_button_phase 0
+#define button_debounce_ms 10   /* Settle time after an edge, in event-driven mode */
+
+static struct exec_task_t button_task = {
+    .name = "buttons",
+    .id = 'B',
+    .run = task_button_read_code,
+    .period_ms = thread_button_period,
+    .phase_ms = thread_button_phase,
+    .prio = thread_button_prio
+};
+
+void task_button_read_code(void) {
+
+    uint32_t values = 0;
+    int64_t now = k_uptime_get();
+
+    /* All buttons are sampled with one access per GPIO port, unless a trace is replayed */
+    if(replay_buttons(&values) || gpio_bank_read(&but_bank, &values) == 0) {
+        replay_record(REPLAY_BUTTONS, values);
+        for(int i = 0; i < N_BUTTONS; i++) {
+            int res = (values >> i) & 1;
+            rtdb_set_button(i, res);
+            gestures_update(i, res, now);
+        }
+        rules_buttons(values);
+#if defined(CONFIG_APP_CAPTURE)
+        capture_buttons(values);
+#endif
+    }
 
-        total_cycles = timing_cycles_get(&start_time, &end_time);
-        total_ns = timing_cycles_to_ns(total_cycles);
-       
-        /* Wait for next release instant */ 
-        fin_time = k_uptime_get();
-        if( fin_time < release_time) {
-            k_msleep(release_time - fin_time); /* There are other variants, k_sleep(), k_usleep(), ... */       
+    /* Without periodic sampling, come back when a held button becomes a long-press */
+    if(opmode_get() == OPMODE_EVENT) {
+        int64_t deadline = gestures_next_deadline();
+        /* A replayed trace has no edge interrupts, come back at its next change */
+        int64_t edge = replay_next_buttons_ms();
+        if(edge >= 0 && (deadline < 0 || edge < deadline)) {
+            deadline = edge;
+        }
+        if(deadline >= 0) {
+            exec_trigger_at(&button_task, deadline);
         }
-        /* Update next release time instant*/
-        release_time += thread_button_period;
-        //k_msleep(TIMER_INTERVAL_MSEC);
     }
-    timing_stop();
 }
 
-int configure_buttons(void) {
-    if (!device_is_ready(but_0.port))  
-	{
-        printk("Fatal error: but0 device not ready!");
-		return ERR_RDY;
-	}
+/* Button edge (ISR context): sample the buttons once they settle */
+static void buttons_edge_handler(struct gpio_bank_t *bank) {
+    opmode_wake(WAKE_SRC_GPIO);
+    exec_trigger_at(&button_task, k_uptime_get() + button_debounce_ms);
+}
 
-    if (!device_is_ready(but_1.port))  
-	{
-        printk("Fatal error: but1 device not ready!");
-		return ERR_RDY;
-	}
+static void buttons_opmode_changed(int mode) {
+    if(mode == OPMODE_EVENT) {
+        /* Buttons are sampled on edges only */
+        gpio_bank_irq_enable(&but_bank, buttons_edge_handler);
+        exec_set_periodic(&button_task, false);
+        exec_trigger(&button_task);
+    } else {
+        gpio_bank_irq_disable(&but_bank);
+        exec_set_periodic(&button_task, true);
+    }
+}
 
-    if (!device_is_ready(but_2.port))  
-	{
-        printk("Fatal error: but2 device not ready!");
+int configure_buttons(void) {
+    int ret = gpio_bank_init(&but_bank, but_pins, N_BUTTONS, GPIO_INPUT);
+    if (ret == -ENODEV) {
         return ERR_RDY;
-	}
-
-    if (!device_is_ready(but_3.port))  
-	{
-        printk("Fatal error: but3 device not ready!");
-		return ERR_RDY;
-	}
-
-    int ret = 0;
-    
-    ret = gpio_pin_configure_dt(&but_0, GPIO_INPUT);
-    if(ret < 0) {
-    	return 0;
-    }
-    ret = gpio_pin_configure_dt(&but_1, GPIO_INPUT);
-    if(ret < 0) {
-    	return 0;
     }
-    ret = gpio_pin_configure_dt(&but_2, GPIO_INPUT);
-    if(ret < 0) {
-    	return 0;
-    }
-    ret = gpio_pin_configure_dt(&but_3, GPIO_INPUT);
-    if(ret < 0) {
-    	return 0;
+    if (ret < 0) {
+        return ret;
     }
     
-    thread_button_tid = k_thread_create(&thread_button_data, thread_button_stack,
-        K_THREAD_STACK_SIZEOF(thread_button_stack), thread_button_read_code,
-        NULL, NULL, NULL, thread_button_prio, 0, K_NO_WAIT);
-
-
+    opmode_register(buttons_opmode_changed);
 
-    return 0;
+    /* Periodic sampling is run by the executive */
+    return exec_register(&button_task);
 }
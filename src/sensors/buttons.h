@@ -16,46 +16,45 @@
 #define __BUTTONS_H__
 
 #include "commons.h"
+#include "gpio_bank.h"
+#include "executive.h"
 
 #define BUT0_NODE DT_ALIAS(sw0)
 #define BUT1_NODE DT_ALIAS(sw1)
 #define BUT2_NODE DT_ALIAS(sw2)
 #define BUT3_NODE DT_ALIAS(sw3)
+#define N_BUTTONS 4
 #define ERR_RDY -1
 
 
 /**
- * @brief Configures the button devices and starts the button reading thread.
+ * @brief Configures the button devices and registers the button reading task.
  *
  * This function checks the readiness of each button device, configures them as
- * GPIO inputs, and creates a thread for reading button states periodically.
+ * GPIO inputs, and registers a task with the executive (see executive.h) for
+ * reading button states periodically.
  *
  * @return int
  * - Returns 0 on successful configuration.
  * - Returns ERR_RDY (-1) if any button device is not ready.
  *
- * @note Ensure that button devices (`but_0`, `but_1`, `but_2`, `but_3`) are properly defined and initialized
- *       before calling this function.
- * @note The button reading thread (`thread_button_read_code`) is created with the specified priority and stack size.
+ * @note The buttons (aliases sw0 to sw3) are configured as a single GPIO bank
+ *       (see gpio_bank.h), so they are sampled with one access per port.
+ * @note The button reading task (`task_button_read_code`) is registered with the specified priority, period and phase.
  *
  */
 int configure_buttons(void);
 
 /**
- * @brief Thread function for reading button states.
+ * @brief Task for reading button states.
  *
- * This thread function continuously reads the state of buttons connected to GPIO pins,
- * updates their state in the real-time database (RTDB), and measures the execution time
- * of the button reading process.
+ * Run periodically by the executive, this job reads the state of buttons connected to GPIO pins,
+ * updates their state in the real-time database (RTDB) and feeds the gesture
+ * classifier (see gestures.h).
  *
- * @param argA Unused parameter.
- * @param argB Unused parameter.
- * @param argC Unused parameter.
- *
- * @note The thread periodicity (thread_button_period) should be properly configured to avoid overrun or underrun.
+ * @note The task periodicity (thread_button_period) should be properly configured to avoid overrun or underrun.
  *
  */
-void thread_button_read_code(void *argA, void *argB, void *argC);
+void task_button_read_code(void);
 
 #endif
-
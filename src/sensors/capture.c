@@ -0,0 +1,196 @@
+/**
+ * @file capture.c
+ * @brief Triggered ADC capture with a pre-trigger buffer.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "capture.h"
+#include "adc.h"
+#include "buttons.h"
+
+BUILD_ASSERT(CONFIG_APP_CAPTURE_PRE_SAMPLES < CONFIG_APP_CAPTURE_SAMPLES,
+             "the capture needs at least one post-trigger sample");
+
+/* Circular buffer, written only by the stream callback while sampling */
+static uint16_t capture_buf[CONFIG_APP_CAPTURE_SAMPLES];
+static uint32_t capture_head;           /* Samples taken since armed */
+static uint32_t capture_trigger_at;     /* Sample count at the trigger sample */
+static uint16_t capture_prev;           /* Previous sample, for the edge triggers */
+static char capture_trigger = CAPTURE_TRIG_COMMAND;
+static uint16_t capture_level;
+
+static atomic_t capture_state = ATOMIC_INIT(CAPTURE_IDLE);
+static atomic_t capture_fire = ATOMIC_INIT(0);  /* Trigger requested by a button or a command */
+static bool capture_reading;
+
+/* Serializes the control calls of the command threads */
+static K_MUTEX_DEFINE(capture_lock);
+
+static bool capture_level_fired(uint16_t raw) {
+    switch(capture_trigger) {
+        case CAPTURE_TRIG_HIGH:
+            return raw >= capture_level;
+        case CAPTURE_TRIG_LOW:
+            return raw <= capture_level;
+        case CAPTURE_TRIG_RISING:
+            return capture_head > 1 && capture_prev < capture_level && raw >= capture_level;
+        case CAPTURE_TRIG_FALLING:
+            return capture_head > 1 && capture_prev > capture_level && raw <= capture_level;
+        default:
+            return false;
+    }
+}
+
+/* Stream callback (ADC completion context), returns false to stop sampling */
+static bool capture_on_sample(uint16_t raw) {
+
+    int state = atomic_get(&capture_state);
+    if(state != CAPTURE_ARMED && state != CAPTURE_TRIGGERED) {
+        /* Stopped */
+        return false;
+    }
+
+    capture_buf[capture_head % CONFIG_APP_CAPTURE_SAMPLES] = raw;
+    capture_head++;
+
+    if(state == CAPTURE_ARMED && (atomic_clear(&capture_fire) || capture_level_fired(raw))) {
+        capture_trigger_at = capture_head - 1;
+        state = CAPTURE_TRIGGERED;
+        /* Fails only if stopped meanwhile, the next sample ends the stream */
+        atomic_cas(&capture_state, CAPTURE_ARMED, CAPTURE_TRIGGERED);
+    }
+    capture_prev = raw;
+
+    if(state == CAPTURE_TRIGGERED && capture_head - capture_trigger_at >= CAPTURE_POST_SAMPLES) {
+        atomic_cas(&capture_state, CAPTURE_TRIGGERED, CAPTURE_DONE);
+        return false;
+    }
+    return true;
+}
+
+int capture_arm(char trigger, uint16_t level) {
+
+    switch(trigger) {
+        case CAPTURE_TRIG_HIGH:
+        case CAPTURE_TRIG_LOW:
+        case CAPTURE_TRIG_RISING:
+        case CAPTURE_TRIG_FALLING:
+            if(level > 1023) {
+                return -EINVAL;
+            }
+            break;
+        case CAPTURE_TRIG_BUTTON:
+            if(level >= N_BUTTONS) {
+                return -EINVAL;
+            }
+            break;
+        case CAPTURE_TRIG_COMMAND:
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    k_mutex_lock(&capture_lock, K_FOREVER);
+
+    int state = atomic_get(&capture_state);
+    /* A stopped stream ends on its next sample */
+    if(state == CAPTURE_ARMED || state == CAPTURE_TRIGGERED || capture_reading || adc_streaming()) {
+        k_mutex_unlock(&capture_lock);
+        return -EBUSY;
+    }
+
+    capture_trigger = trigger;
+    capture_level = level;
+    capture_head = 0;
+    capture_trigger_at = 0;
+    atomic_clear(&capture_fire);
+    atomic_set(&capture_state, CAPTURE_ARMED);
+
+    int err = adc_stream_start(CONFIG_APP_CAPTURE_INTERVAL_US, capture_on_sample);
+    if(err) {
+        atomic_set(&capture_state, CAPTURE_IDLE);
+    }
+
+    k_mutex_unlock(&capture_lock);
+    return err;
+}
+
+int capture_force(void) {
+    if(atomic_get(&capture_state) != CAPTURE_ARMED) {
+        return -EAGAIN;
+    }
+    atomic_set(&capture_fire, 1);
+    return 0;
+}
+
+void capture_buttons(uint32_t values) {
+    if(atomic_get(&capture_state) == CAPTURE_ARMED && capture_trigger == CAPTURE_TRIG_BUTTON &&
+       (values >> capture_level) & 1) {
+        atomic_set(&capture_fire, 1);
+    }
+}
+
+int capture_stop(void) {
+
+    k_mutex_lock(&capture_lock, K_FOREVER);
+    if(capture_reading) {
+        k_mutex_unlock(&capture_lock);
+        return -EBUSY;
+    }
+    atomic_set(&capture_state, CAPTURE_IDLE);
+    k_mutex_unlock(&capture_lock);
+    return 0;
+}
+
+void capture_info_get(struct capture_info_t *info) {
+
+    uint32_t head = capture_head;
+
+    info->state = atomic_get(&capture_state);
+    info->trigger = capture_trigger;
+    info->level = capture_level;
+    info->interval_us = CONFIG_APP_CAPTURE_INTERVAL_US;
+    info->samples = MIN(head, CONFIG_APP_CAPTURE_SAMPLES);
+    info->trigger_idx = 0;
+    if(info->state == CAPTURE_TRIGGERED || info->state == CAPTURE_DONE) {
+        info->trigger_idx = capture_trigger_at - (head - info->samples);
+    }
+}
+
+int capture_read_begin(struct capture_info_t *info) {
+
+    k_mutex_lock(&capture_lock, K_FOREVER);
+    if(atomic_get(&capture_state) != CAPTURE_DONE || capture_reading) {
+        k_mutex_unlock(&capture_lock);
+        return -EAGAIN;
+    }
+    capture_reading = true;
+    capture_info_get(info);
+    k_mutex_unlock(&capture_lock);
+    return 0;
+}
+
+uint16_t capture_get(uint32_t idx) {
+    uint32_t samples = MIN(capture_head, CONFIG_APP_CAPTURE_SAMPLES);
+    return capture_buf[(capture_head - samples + idx) % CONFIG_APP_CAPTURE_SAMPLES];
+}
+
+void capture_read_end(void) {
+    k_mutex_lock(&capture_lock, K_FOREVER);
+    capture_reading = false;
+    k_mutex_unlock(&capture_lock);
+}
+
+const char *capture_state_name(int state) {
+    switch(state) {
+        case CAPTURE_IDLE: return "IDLE";
+        case CAPTURE_ARMED: return "ARMED";
+        case CAPTURE_TRIGGERED: return "TRIGGERED";
+        case CAPTURE_DONE: return "DONE";
+        default: return "?";
+    }
+}
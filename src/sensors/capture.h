@@ -0,0 +1,150 @@
+/**
+ * @file capture.h
+ * @brief Triggered ADC capture with a pre-trigger buffer.
+ *
+ * This header file declares an oscilloscope-style capture of the ADC channel,
+ * enabled with CONFIG_APP_CAPTURE. Once armed, the channel is sampled every
+ * CONFIG_APP_CAPTURE_INTERVAL_US by the ADC driver (see adc_stream_start())
+ * into a circular buffer of CONFIG_APP_CAPTURE_SAMPLES samples. When the
+ * trigger fires, CAPTURE_POST_SAMPLES more samples are taken (the trigger
+ * sample included) and the buffer is frozen, holding up to
+ * CONFIG_APP_CAPTURE_PRE_SAMPLES samples before the trigger.
+ *
+ * Triggers: the sample reaching a level (at or above, at or below), the
+ * sample crossing a level (rising or falling edge), a button being pressed,
+ * or a command. Normal acquisition goes on meanwhile: the ADC task takes the
+ * latest captured sample.
+ *
+ * The frozen capture is downloaded as a binary block with the 'CD' command
+ * and decoded on the host by tools/capture/capture_dump.py.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <zephyr/kernel.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CAPTURE_POST_SAMPLES (CONFIG_APP_CAPTURE_SAMPLES - CONFIG_APP_CAPTURE_PRE_SAMPLES)
+
+/* Capture states */
+#define CAPTURE_IDLE 0          /* Not sampling, nothing captured */
+#define CAPTURE_ARMED 1         /* Sampling, waiting for the trigger */
+#define CAPTURE_TRIGGERED 2     /* Sampling the post-trigger window */
+#define CAPTURE_DONE 3          /* Frozen, ready to be downloaded */
+
+/* Trigger types */
+#define CAPTURE_TRIG_HIGH 'H'       /* Sample at or above the level */
+#define CAPTURE_TRIG_LOW 'L'        /* Sample at or below the level */
+#define CAPTURE_TRIG_RISING 'R'     /* Sample crossing the level upwards */
+#define CAPTURE_TRIG_FALLING 'F'    /* Sample crossing the level downwards */
+#define CAPTURE_TRIG_BUTTON 'B'     /* Button (index given as the level) pressed */
+#define CAPTURE_TRIG_COMMAND 'C'    /* capture_force() only */
+
+/**
+ * @struct capture_info_t
+ *
+ * @brief State and layout of the capture.
+ */
+struct capture_info_t {
+    int state;                  /* CAPTURE_* state */
+    char trigger;               /* CAPTURE_TRIG_* type of the last arm */
+    uint16_t level;             /* Raw level (0-1023) or button index */
+    uint32_t interval_us;       /* Sampling interval */
+    uint32_t samples;           /* Samples held, oldest first */
+    uint32_t trigger_idx;       /* Index of the trigger sample, valid once triggered */
+};
+
+/**
+ * @brief Arm the capture.
+ *
+ * Discards the previous capture and starts sampling.
+ *
+ * @param trigger Trigger type (CAPTURE_TRIG_*).
+ * @param level Raw level (0-1023), or button index for CAPTURE_TRIG_BUTTON.
+ *
+ * @return int
+ * - Returns 0 if armed.
+ * - Returns -EINVAL for an unknown trigger or a level out of range.
+ * - Returns -EBUSY if a capture is in progress or being downloaded.
+ * - Returns a negative error code if sampling could not be started.
+ */
+int capture_arm(char trigger, uint16_t level);
+
+/**
+ * @brief Trigger an armed capture on the next sample.
+ *
+ * @return int
+ * - Returns 0 if the capture was armed.
+ * - Returns -EAGAIN otherwise.
+ */
+int capture_force(void);
+
+/**
+ * @brief Feed the button states to the button trigger.
+ *
+ * Called by the button task after every read.
+ *
+ * @param values Button states, bit i set when button i is pressed.
+ */
+void capture_buttons(uint32_t values);
+
+/**
+ * @brief Stop sampling and discard the capture.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EBUSY if the capture is being downloaded.
+ */
+int capture_stop(void);
+
+/**
+ * @brief Get the state of the capture.
+ *
+ * @param info Destination.
+ */
+void capture_info_get(struct capture_info_t *info);
+
+/**
+ * @brief Lock the frozen capture for reading.
+ *
+ * Must be followed by capture_read_end(). Arming and stopping fail meanwhile.
+ *
+ * @param info Set to the layout of the capture.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EAGAIN if no capture is frozen.
+ */
+int capture_read_begin(struct capture_info_t *info);
+
+/**
+ * @brief Get a sample of the frozen capture.
+ *
+ * @param idx Sample index, 0 is the oldest.
+ *
+ * @return uint16_t Raw sample.
+ */
+uint16_t capture_get(uint32_t idx);
+
+/**
+ * @brief Release the frozen capture, which can be downloaded again.
+ */
+void capture_read_end(void);
+
+/**
+ * @brief Returns a printable name for a capture state.
+ *
+ * @param state CAPTURE_* state.
+ *
+ * @return const char* Name of the state.
+ */
+const char *capture_state_name(int state);
+
+#endif
@@ -10,7 +10,5 @@
 #include <zephyr/sys/printk.h>      /* for printk()*/
 #include <string.h>
 #include <zephyr/timing/timing.h>   /* for timing services */
-/*ADC definitions and includes*/
-#include <hal/nrf_saadc.h>
 #include "rtdb.h"
 #endif
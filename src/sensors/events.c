@@ -0,0 +1,88 @@
+/**
+ * @file events.c
+ * @brief Bounded, timestamped event log drained by the host.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "events.h"
+
+static struct event_item_t event_ring[EVENT_RING_SIZE];
+static uint16_t event_head = 0;     /* Index of the oldest event */
+static uint16_t event_count = 0;    /* Number of events currently stored */
+static uint32_t event_lost = 0;     /* Events overwritten since the last drain */
+static uint16_t event_high_water = 0;   /* Max events stored at the same time */
+
+/* Producers may run in different threads, keep the critical sections short */
+static struct k_spinlock event_lock;
+
+void events_push(uint8_t source, uint8_t id, uint8_t type) {
+    k_spinlock_key_t key = k_spin_lock(&event_lock);
+
+    uint16_t tail = (event_head + event_count) % EVENT_RING_SIZE;
+
+    if(event_count == EVENT_RING_SIZE) {
+        /* Ring is full, drop the oldest event */
+        event_head = (event_head + 1) % EVENT_RING_SIZE;
+        event_lost++;
+    } else {
+        event_count++;
+        if(event_count > event_high_water) {
+            event_high_water = event_count;
+        }
+    }
+
+    event_ring[tail].timestamp = k_uptime_get_32();
+    event_ring[tail].source = source;
+    event_ring[tail].id = id;
+    event_ring[tail].type = type;
+
+    k_spin_unlock(&event_lock, key);
+}
+
+int events_pop(struct event_item_t *ev) {
+    int ret = 0;
+    k_spinlock_key_t key = k_spin_lock(&event_lock);
+
+    if(event_count > 0) {
+        *ev = event_ring[event_head];
+        event_head = (event_head + 1) % EVENT_RING_SIZE;
+        event_count--;
+        ret = 1;
+    }
+
+    k_spin_unlock(&event_lock, key);
+    return ret;
+}
+
+uint32_t events_take_lost(void) {
+    k_spinlock_key_t key = k_spin_lock(&event_lock);
+    uint32_t lost = event_lost;
+    event_lost = 0;
+    k_spin_unlock(&event_lock, key);
+    return lost;
+}
+
+uint16_t events_high_water(void) {
+    return event_high_water;
+}
+
+const char *events_type_name(uint8_t type) {
+    switch(type) {
+        case EVT_PRESS:
+            return "PRESS";
+        case EVT_RELEASE:
+            return "RELEASE";
+        case EVT_LONG_PRESS:
+            return "LONG";
+        case EVT_DOUBLE_CLICK:
+            return "DOUBLE";
+        case EVT_DEADLINE_MISS:
+            return "DEADLINE_MISS";
+        default:
+            return "UNKNOWN";
+    }
+}
@@ -0,0 +1,97 @@
+/**
+ * @file events.h
+ * @brief Bounded, timestamped event log drained by the host.
+ *
+ * This header file declares a fixed-size ring of timestamped events produced
+ * on the device (e.g. button gestures). The host drains the whole ring with a
+ * single UART command, so it can poll rarely without losing input.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __EVENTS_H__
+#define __EVENTS_H__
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+#define EVENT_RING_SIZE 32      /* Number of events kept until the host drains them */
+
+/* Event sources */
+#define EVT_SRC_BUTTON 'B'
+#define EVT_SRC_TASK 'T'    /* Periodic task, id is the one-letter task ID */
+
+/* Event types */
+#define EVT_PRESS 0
+#define EVT_RELEASE 1
+#define EVT_LONG_PRESS 2
+#define EVT_DOUBLE_CLICK 3
+#define EVT_DEADLINE_MISS 4
+
+/**
+ * @struct event_item_t
+ *
+ * @brief Structure representing a logged event.
+ *
+ * Holds the uptime (in ms) at which the event was detected, the source that
+ * produced it, the index of the element within that source (e.g. button 0-3)
+ * and the event type.
+ *
+ */
+struct event_item_t {
+    uint32_t timestamp;
+    uint8_t source;
+    uint8_t id;
+    uint8_t type;
+};
+
+/**
+ * @brief Appends an event to the log.
+ *
+ * The event is timestamped with the current uptime. When the ring is full the
+ * oldest event is overwritten and the lost counter is incremented.
+ *
+ * @param source Source of the event (EVT_SRC_*).
+ * @param id Index of the element within the source.
+ * @param type Event type (EVT_*).
+ */
+void events_push(uint8_t source, uint8_t id, uint8_t type);
+
+/**
+ * @brief Removes the oldest event from the log.
+ *
+ * @param ev Pointer to store the event.
+ *
+ * @return int
+ * - Returns 1 if an event was retrieved.
+ * - Returns 0 if the log is empty.
+ */
+int events_pop(struct event_item_t *ev);
+
+/**
+ * @brief Returns and clears the number of events overwritten since the last call.
+ *
+ * @return uint32_t Number of events lost because the ring was full.
+ */
+uint32_t events_take_lost(void);
+
+/**
+ * @brief Returns the maximum number of events that were stored at the same time.
+ *
+ * @return uint16_t High-water mark of the ring (at most EVENT_RING_SIZE).
+ */
+uint16_t events_high_water(void);
+
+/**
+ * @brief Returns a printable name for an event type.
+ *
+ * @param type Event type (EVT_*).
+ *
+ * @return const char* Name of the event type.
+ */
+const char *events_type_name(uint8_t type);
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * @file gestures.c
+ * @brief On-device button gesture classification.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "gestures.h"
+#include "rules.h"
+#include "../config/persist.h"
+
+/**
+ * @struct gesture_state_t
+ *
+ * @brief Per-button gesture detection state.
+ */
+struct gesture_state_t {
+    uint8_t pressed;        /* Last sampled level */
+    uint8_t long_fired;     /* A long-press was already reported for the current press */
+    uint8_t second_click;   /* Current press started inside the double-click window */
+    int64_t press_time;     /* Instant of the last press */
+    int64_t click_time;     /* Release instant of the last short click, -1 if none */
+};
+
+static struct gesture_state_t gesture_state[GESTURE_N_BUTTONS] = {
+    [0 ... GESTURE_N_BUTTONS - 1] = { .click_time = -1 }
+};
+
+/* Logs a gesture and hands it to the rules engine */
+static void gestures_emit(int id, uint8_t type) {
+    events_push(EVT_SRC_BUTTON, id, type);
+    rules_event(id, type);
+}
+
+static atomic_t long_press_ms = ATOMIC_INIT(GESTURE_LONG_PRESS_DEFAULT);
+static atomic_t double_click_ms = ATOMIC_INIT(GESTURE_DOUBLE_CLICK_DEFAULT);
+
+void gestures_update(int id, int level, int64_t now) {
+
+    struct gesture_state_t *st = &gesture_state[id];
+    level = (level != 0);
+
+    if(level && !st->pressed) {
+        /* Press edge */
+        st->second_click = (st->click_time >= 0 &&
+                            now - st->click_time <= atomic_get(&double_click_ms));
+        st->press_time = now;
+        st->long_fired = 0;
+        gestures_emit(id, EVT_PRESS);
+    } else if(!level && st->pressed) {
+        /* Release edge */
+        gestures_emit(id, EVT_RELEASE);
+        if(st->long_fired) {
+            st->click_time = -1;
+        } else if(st->second_click) {
+            gestures_emit(id, EVT_DOUBLE_CLICK);
+            st->click_time = -1;
+        } else {
+            st->click_time = now;
+        }
+    } else if(level && !st->long_fired &&
+              now - st->press_time >= atomic_get(&long_press_ms)) {
+        /* Held long enough */
+        gestures_emit(id, EVT_LONG_PRESS);
+        st->long_fired = 1;
+    }
+
+    st->pressed = level;
+}
+
+int64_t gestures_next_deadline(void) {
+    int64_t next = -1;
+    for(int i = 0; i < GESTURE_N_BUTTONS; i++) {
+        struct gesture_state_t *st = &gesture_state[i];
+        if(st->pressed && !st->long_fired) {
+            int64_t deadline = st->press_time + atomic_get(&long_press_ms);
+            if(next < 0 || deadline < next) {
+                next = deadline;
+            }
+        }
+    }
+    return next;
+}
+
+int gestures_set_long_press(int ms) {
+    if(ms < GESTURE_TIME_MIN || ms > GESTURE_TIME_MAX) {
+        return -EINVAL;
+    }
+    atomic_set(&long_press_ms, ms);
+    persist_touch(PERSIST_GESTURES);
+    return 0;
+}
+
+int gestures_set_double_click(int ms) {
+    if(ms < GESTURE_TIME_MIN || ms > GESTURE_TIME_MAX) {
+        return -EINVAL;
+    }
+    atomic_set(&double_click_ms, ms);
+    persist_touch(PERSIST_GESTURES);
+    return 0;
+}
+
+void gestures_get_timing(int *long_press, int *double_click) {
+    *long_press = atomic_get(&long_press_ms);
+    *double_click = atomic_get(&double_click_ms);
+}
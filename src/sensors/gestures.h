@@ -0,0 +1,83 @@
+/**
+ * @file gestures.h
+ * @brief On-device button gesture classification.
+ *
+ * This header file declares a per-button state machine that turns the sampled
+ * button levels into press, release, long-press and double-click events. The
+ * detected gestures are appended to the event log (see events.h).
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __GESTURES_H__
+#define __GESTURES_H__
+
+#include "events.h"
+
+#define GESTURE_N_BUTTONS 4
+
+/* Default timings (in ms) */
+#define GESTURE_LONG_PRESS_DEFAULT 800      /* Hold time that makes a press a long-press */
+#define GESTURE_DOUBLE_CLICK_DEFAULT 400    /* Max gap between a release and the next press of a double-click */
+
+/* Accepted timing bounds (in ms) */
+#define GESTURE_TIME_MIN 50
+#define GESTURE_TIME_MAX 5000
+
+/**
+ * @brief Feeds a new sample of a button into its gesture state machine.
+ *
+ * Must be called periodically for every button, with a period well below the
+ * configured timings, as it is also responsible for detecting long-presses
+ * while the button is held.
+ *
+ * @param id ID of the button (0-3).
+ * @param level Logical level of the button (1 pressed, 0 released).
+ * @param now Current uptime in ms.
+ */
+void gestures_update(int id, int level, int64_t now);
+
+/**
+ * @brief Returns the next instant at which a held button becomes a long-press.
+ *
+ * Used when buttons are not sampled periodically, to sample them again at the
+ * instant a long-press has to be reported.
+ *
+ * @return int64_t Uptime in ms, or -1 if no button is waiting for a long-press.
+ */
+int64_t gestures_next_deadline(void);
+
+/**
+ * @brief Sets the long-press hold time.
+ *
+ * @param ms Hold time in ms (GESTURE_TIME_MIN to GESTURE_TIME_MAX).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if the value is out of bounds.
+ */
+int gestures_set_long_press(int ms);
+
+/**
+ * @brief Sets the double-click window.
+ *
+ * @param ms Window in ms (GESTURE_TIME_MIN to GESTURE_TIME_MAX).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if the value is out of bounds.
+ */
+int gestures_set_double_click(int ms);
+
+/**
+ * @brief Reads the current gesture timings.
+ *
+ * @param long_press Pointer to store the long-press hold time (ms).
+ * @param double_click Pointer to store the double-click window (ms).
+ */
+void gestures_get_timing(int *long_press, int *double_click);
+
+#endif
@@ -0,0 +1,168 @@
+/**
+ * @file gpio_bank.c
+ * @brief Groups of GPIO pins read and written with one access per port.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "gpio_bank.h"
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(app_gpio_bank, CONFIG_APP_GPIO_BANK_LOG_LEVEL);
+
+int gpio_bank_init(struct gpio_bank_t *bank, const struct gpio_dt_spec *pins, uint8_t n_pins, gpio_flags_t flags) {
+
+    if(n_pins > GPIO_BANK_MAX_PINS) {
+        return -EINVAL;
+    }
+
+    bank->pins = pins;
+    bank->n_pins = n_pins;
+    bank->n_ports = 0;
+    bank->handler = NULL;
+    bank->cb_added = 0;
+
+    for(int i = 0; i < n_pins; i++) {
+        if (!device_is_ready(pins[i].port)) {
+            LOG_ERR("Fatal error: gpio bank pin %d device not ready!", i);
+            return -ENODEV;
+        }
+
+        int ret = gpio_pin_configure_dt(&pins[i], flags);
+        if(ret < 0) {
+            LOG_ERR("gpio_pin_configure_dt() failed for pin %d with error code %d", i, ret);
+            return ret;
+        }
+
+        /* Find (or add) the port of this pin */
+        int p;
+        for(p = 0; p < bank->n_ports; p++) {
+            if(bank->ports[p].port == pins[i].port) {
+                break;
+            }
+        }
+        if(p == bank->n_ports) {
+            if(bank->n_ports == GPIO_BANK_MAX_PORTS) {
+                return -EINVAL;
+            }
+            bank->ports[p].port = pins[i].port;
+            bank->ports[p].mask = 0;
+            bank->ports[p].active_low = 0;
+            bank->ports[p].bank = bank;
+            bank->n_ports++;
+        }
+
+        bank->pin_port[i] = p;
+        bank->ports[p].mask |= BIT(pins[i].pin);
+        if(pins[i].dt_flags & GPIO_ACTIVE_LOW) {
+            bank->ports[p].active_low |= BIT(pins[i].pin);
+        }
+    }
+
+    return 0;
+}
+
+int gpio_bank_read(const struct gpio_bank_t *bank, uint32_t *values) {
+
+    gpio_port_value_t port_val[GPIO_BANK_MAX_PORTS];
+
+    /* One register read per port */
+    for(int p = 0; p < bank->n_ports; p++) {
+        int ret = gpio_port_get_raw(bank->ports[p].port, &port_val[p]);
+        if(ret < 0) {
+            return ret;
+        }
+        port_val[p] ^= bank->ports[p].active_low;
+    }
+
+    uint32_t res = 0;
+    for(int i = 0; i < bank->n_pins; i++) {
+        if(port_val[bank->pin_port[i]] & BIT(bank->pins[i].pin)) {
+            res |= BIT(i);
+        }
+    }
+
+    *values = res;
+    return 0;
+}
+
+int gpio_bank_write(struct gpio_bank_t *bank, uint32_t mask, uint32_t values) {
+
+    gpio_port_pins_t port_mask[GPIO_BANK_MAX_PORTS] = {0};
+    gpio_port_value_t port_val[GPIO_BANK_MAX_PORTS] = {0};
+
+    for(int i = 0; i < bank->n_pins; i++) {
+        if(mask & BIT(i)) {
+            uint8_t p = bank->pin_port[i];
+            port_mask[p] |= BIT(bank->pins[i].pin);
+            if(values & BIT(i)) {
+                port_val[p] |= BIT(bank->pins[i].pin);
+            }
+        }
+    }
+
+    /* One register write per touched port */
+    int ret = 0;
+    k_spinlock_key_t key = k_spin_lock(&bank->lock);
+    for(int p = 0; p < bank->n_ports && ret == 0; p++) {
+        if(port_mask[p] == 0) {
+            continue;
+        }
+        ret = gpio_port_set_masked_raw(bank->ports[p].port, port_mask[p],
+                                       port_val[p] ^ bank->ports[p].active_low);
+    }
+    k_spin_unlock(&bank->lock, key);
+
+    return ret;
+}
+
+static void gpio_bank_port_cb(const struct device *port, struct gpio_callback *cb, gpio_port_pins_t pins) {
+    struct gpio_bank_port_t *bank_port = CONTAINER_OF(cb, struct gpio_bank_port_t, cb);
+    gpio_bank_handler_t handler = bank_port->bank->handler;
+
+    if(handler != NULL) {
+        handler(bank_port->bank);
+    }
+}
+
+int gpio_bank_irq_enable(struct gpio_bank_t *bank, gpio_bank_handler_t handler) {
+
+    int ret;
+    bank->handler = handler;
+
+    if(!bank->cb_added) {
+        for(int p = 0; p < bank->n_ports; p++) {
+            gpio_init_callback(&bank->ports[p].cb, gpio_bank_port_cb, bank->ports[p].mask);
+            ret = gpio_add_callback(bank->ports[p].port, &bank->ports[p].cb);
+            if(ret < 0) {
+                return ret;
+            }
+        }
+        bank->cb_added = 1;
+    }
+
+    for(int i = 0; i < bank->n_pins; i++) {
+        ret = gpio_pin_interrupt_configure_dt(&bank->pins[i], GPIO_INT_EDGE_BOTH);
+        if(ret < 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+int gpio_bank_irq_disable(struct gpio_bank_t *bank) {
+
+    for(int i = 0; i < bank->n_pins; i++) {
+        int ret = gpio_pin_interrupt_configure_dt(&bank->pins[i], GPIO_INT_DISABLE);
+        if(ret < 0) {
+            return ret;
+        }
+    }
+    bank->handler = NULL;
+
+    return 0;
+}
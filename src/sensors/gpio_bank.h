@@ -0,0 +1,142 @@
+/**
+ * @file gpio_bank.h
+ * @brief Groups of GPIO pins read and written with one access per port.
+ *
+ * This header file declares a GPIO bank: an ordered set of pins, built from an
+ * array of `gpio_dt_spec` (typically taken from devicetree aliases), that is
+ * grouped by port at configuration time. Reading or writing the whole bank
+ * then costs a single `gpio_port_get_raw`/`gpio_port_set_masked_raw` call per
+ * port instead of one call per pin.
+ *
+ * Values are exchanged as bit masks where bit i holds the logical level of the
+ * i-th pin of the bank (active-low pins are inverted by the bank). Writes are
+ * serialized, so different pins of a bank can be driven from threads and from
+ * timer/ISR context at the same time.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __GPIO_BANK_H__
+#define __GPIO_BANK_H__
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/gpio.h>
+#include <stdint.h>
+
+#define GPIO_BANK_MAX_PINS 8    /* Max pins per bank */
+#define GPIO_BANK_MAX_PORTS 4   /* Max different ports per bank */
+
+struct gpio_bank_t;
+
+/**
+ * @brief Callback invoked (in ISR context) when a pin of a bank changes.
+ *
+ * @param bank Bank that raised the interrupt.
+ */
+typedef void (*gpio_bank_handler_t)(struct gpio_bank_t *bank);
+
+/**
+ * @struct gpio_bank_port_t
+ *
+ * @brief Pins of a bank that live in the same GPIO port.
+ */
+struct gpio_bank_port_t {
+    const struct device *port;
+    gpio_port_pins_t mask;          /* Pins of the port that belong to the bank */
+    gpio_port_pins_t active_low;    /* Subset of mask that is active low */
+    struct gpio_callback cb;        /* Edge interrupt callback of the port */
+    struct gpio_bank_t *bank;       /* Back reference used by the callback */
+};
+
+/**
+ * @struct gpio_bank_t
+ *
+ * @brief GPIO bank descriptor.
+ *
+ * Filled by gpio_bank_init(), should not be modified afterwards.
+ */
+struct gpio_bank_t {
+    const struct gpio_dt_spec *pins;
+    uint8_t n_pins;
+    uint8_t n_ports;
+    uint8_t pin_port[GPIO_BANK_MAX_PINS];  /* Index in ports[] of each pin */
+    struct gpio_bank_port_t ports[GPIO_BANK_MAX_PORTS];
+    struct k_spinlock lock;     /* Serializes the read-modify-write of the port outputs */
+    gpio_bank_handler_t handler;    /* Edge handler, NULL when interrupts are disabled */
+    uint8_t cb_added;               /* Port callbacks already registered with the drivers */
+};
+
+/**
+ * @brief Initializes a GPIO bank and configures all its pins.
+ *
+ * Checks that the port of every pin is ready, configures each pin with the
+ * given flags and groups the pins by port.
+ *
+ * @param bank Bank to initialize.
+ * @param pins Array of pin specifications, must outlive the bank.
+ * @param n_pins Number of pins (at most GPIO_BANK_MAX_PINS).
+ * @param flags GPIO flags used to configure every pin (e.g. GPIO_INPUT).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if the bank has too many pins or ports.
+ * - Returns -ENODEV if a port is not ready.
+ * - Returns a negative error code if a pin could not be configured.
+ */
+int gpio_bank_init(struct gpio_bank_t *bank, const struct gpio_dt_spec *pins, uint8_t n_pins, gpio_flags_t flags);
+
+/**
+ * @brief Reads the logical level of every pin of the bank.
+ *
+ * @param bank Bank to read.
+ * @param values Pointer to store the levels (bit i is pin i).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns a negative error code if a port could not be read.
+ */
+int gpio_bank_read(const struct gpio_bank_t *bank, uint32_t *values);
+
+/**
+ * @brief Sets the logical level of a subset of the pins of the bank.
+ *
+ * Only the ports that hold at least one pin selected by mask are accessed.
+ *
+ * @param bank Bank to write.
+ * @param mask Pins to update (bit i is pin i).
+ * @param values Levels to set (bit i is pin i), bits outside mask are ignored.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns a negative error code if a port could not be written.
+ */
+int gpio_bank_write(struct gpio_bank_t *bank, uint32_t mask, uint32_t values);
+
+/**
+ * @brief Enables edge interrupts (both edges) on every pin of an input bank.
+ *
+ * @param bank Bank.
+ * @param handler Callback invoked, in ISR context, on every edge.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns a negative error code if an interrupt could not be configured.
+ */
+int gpio_bank_irq_enable(struct gpio_bank_t *bank, gpio_bank_handler_t handler);
+
+/**
+ * @brief Disables the edge interrupts of a bank.
+ *
+ * @param bank Bank.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns a negative error code if an interrupt could not be disabled.
+ */
+int gpio_bank_irq_disable(struct gpio_bank_t *bank);
+
+#endif
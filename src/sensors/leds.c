@@ -13,117 +13,102 @@
  */
 
 #include "leds.h"
+#include "pwm_leds.h"
+#include "opmode.h"
 
-const struct gpio_dt_spec led_0 = GPIO_DT_SPEC_GET(LED0_NODE,gpios);
-const struct gpio_dt_spec led_1 = GPIO_DT_SPEC_GET(LED1_NODE,gpios);
-const struct gpio_dt_spec led_2 = GPIO_DT_SPEC_GET(LED2_NODE,gpios);
-const struct gpio_dt_spec led_3 = GPIO_DT_SPEC_GET(LED3_NODE,gpios);
+/* LEDs, in ID order, handled as a single GPIO bank */
+static const struct gpio_dt_spec led_pins[N_LEDS] = {
+    GPIO_DT_SPEC_GET(LED0_NODE,gpios),
+    GPIO_DT_SPEC_GET(LED1_NODE,gpios),
+    GPIO_DT_SPEC_GET(LED2_NODE,gpios),
+    GPIO_DT_SPEC_GET(LED3_NODE,gpios)
+};
+static struct gpio_bank_t led_bank;
 
-#define STACK_SIZE 1024
 #define thread_led_prio 3 
-#define thread_led_period 1000
-K_THREAD_STACK_DEFINE(thread_led_stack, STACK_SIZE);
-struct k_thread thread_led_data;
-k_tid_t thread_led_tid;
-
-void thread_led_set_code(void *argA, void *argB, void *argC) {
-
-    timing_t fin_time=0, release_time=0;
-    
-    /* Variables to time execution */
-    timing_t start_time, end_time;
-    uint64_t total_cycles=0;
-    uint64_t total_ns=0;
-
-    /* Compute next release instant */
-    release_time = k_uptime_get() + thread_led_period;
-
-    while(true){
-        /* Get one sample, checks for errors and prints the values */
-	start_time = timing_counter_get(); 
-	
-	int res = 0;
-	int ret = 0;
-	rtdb_read_led(0, &res);
-    	ret = gpio_pin_set_dt(&led_0, res);    
-	if (ret < 0) {
-	    return;
-    	}
-	rtdb_read_led(1, &res);
-    	ret = gpio_pin_set_dt(&led_1, res);    
-	if (ret < 0) {
-	    return;
-    	}
-	rtdb_read_led(2, &res);
-    	ret = gpio_pin_set_dt(&led_2, res);    
-	if (ret < 0) {
-	    return;
-    	}
-	rtdb_read_led(3, &res);
-    	ret = gpio_pin_set_dt(&led_3, res);    
-	if (ret < 0) {
-	    return;
-    	}
-
-        end_time = timing_counter_get();
-
-        total_cycles = timing_cycles_get(&start_time, &end_time);
-        total_ns = timing_cycles_to_ns(total_cycles);
-       
-        /* Wait for next release instant */ 
-        fin_time = k_uptime_get();
-        if( fin_time < release_time) {
-            k_msleep(release_time - fin_time); /* There are other variants, k_sleep(), k_usleep(), ... */       
-        }
-        /* Update next release time instant*/
-        release_time += thread_led_period;
-        //k_msleep(TIMER_INTERVAL_MSEC);
-    }
-    timing_stop();
-}
+#define thread_led_period 1000   /* Default, can be changed at runtime (see exec_set_period()) */
+#define thread_led_phase 10     /* Released after the buttons and the ADC */
 
-int configure_leds(void) {
+static struct exec_task_t led_task = {
+    .name = "leds",
+    .id = 'L',
+    .run = task_led_set_code,
+    .period_ms = thread_led_period,
+    .phase_ms = thread_led_phase,
+    .prio = thread_led_prio
+};
+
+/* Levels last written to the LED GPIOs, valid for the LEDs in led_written_mask */
+static uint32_t led_written_values = 0;
+static uint32_t led_written_mask = 0;
+
+/* Binary LED write: GPIO bank, except for the LEDs whose pin belongs to a PWM channel */
+static int leds_write(uint32_t mask, uint32_t values) {
+    uint32_t hw_mask = mask & pwm_leds_hw_mask();
     int ret = 0;
-    if (!device_is_ready(led_0.port))  
-    {
-    printk("Fatal error: led0 device not ready!");
-    	return ERR_RDY;
-    }
-    if (!device_is_ready(led_1.port))  
-    {
-    printk("Fatal error: led1 device not ready!");
-    	return ERR_RDY;
-    }
-    if (!device_is_ready(led_2.port))  
-    {
-    printk("Fatal error: led2 device not ready!");
-    	return ERR_RDY;
+
+    if(mask & ~hw_mask) {
+        ret = gpio_bank_write(&led_bank, mask & ~hw_mask, values);
     }
-    if (!device_is_ready(led_3.port))  
-    {
-    printk("Fatal error: led3 device not ready!");
-    	return ERR_RDY;
+    if(hw_mask && ret == 0) {
+        ret = pwm_leds_write_level(hw_mask, values);
     }
+    return ret;
+}
+
+void task_led_set_code(void) {
 
-    ret = gpio_pin_configure_dt(&led_0, GPIO_OUTPUT_INACTIVE);
-    if(ret < 0) {
-    	return 0;
+    /* One consistent snapshot: the LEDs of a transaction are written in the same update */
+    uint32_t values;
+    rtdb_read_leds(&values);
+
+    /* LEDs played back by the PWM engine are not ours, and the level of those
+       it drove since the last activation is unknown */
+    uint32_t pwm_mask = pwm_leds_active_mask();
+    led_written_mask &= ~(pwm_mask | pwm_leds_take_driven());
+
+    /* Only the LEDs whose GPIO does not already hold the right level are written,
+       all of them with one access per GPIO port */
+    uint32_t up_to_date = led_written_mask & ~(values ^ led_written_values);
+    uint32_t to_write = BIT_MASK(N_LEDS) & ~pwm_mask & ~up_to_date;
+    if(to_write && leds_write(to_write, values) == 0) {
+        led_written_values = (led_written_values & ~to_write) | (values & to_write);
+        led_written_mask |= to_write;
     }
-    ret = gpio_pin_configure_dt(&led_1, GPIO_OUTPUT_INACTIVE);
-    if(ret < 0) {
-    	return 0;
+}
+
+/* RTDB LED write: in event-driven mode this is what releases the LED task */
+static void leds_rtdb_changed(uint32_t mask) {
+    if(opmode_get() == OPMODE_EVENT) {
+        exec_trigger(&led_task);
     }
-    ret = gpio_pin_configure_dt(&led_2, GPIO_OUTPUT_INACTIVE);
-    if(ret < 0) {
-    	return 0;
+}
+
+static void leds_opmode_changed(int mode) {
+    exec_set_periodic(&led_task, mode != OPMODE_EVENT);
+    exec_trigger(&led_task);
+}
+
+int leds_output(uint32_t mask, uint32_t values) {
+    return gpio_bank_write(&led_bank, mask, values);
+}
+
+int configure_leds(void) {
+    int ret = gpio_bank_init(&led_bank, led_pins, N_LEDS, GPIO_OUTPUT_INACTIVE);
+    if (ret == -ENODEV) {
+        return ERR_RDY;
     }
-    ret = gpio_pin_configure_dt(&led_3, GPIO_OUTPUT_INACTIVE);
-    if(ret < 0) {
-    	return 0;
+    if (ret < 0) {
+        return ret;
     }
-    thread_led_tid = k_thread_create(&thread_led_data, thread_led_stack,
-        K_THREAD_STACK_SIZEOF(thread_led_stack), thread_led_set_code,
-        NULL, NULL, NULL, thread_led_prio, 0, K_NO_WAIT);
-    return 0;
+
+    pwm_leds_init();
+
+    rtdb_set_led_listener(leds_rtdb_changed);
+    opmode_register(leds_opmode_changed);
+
+    /* Periodic refresh is run by the executive */
+    return exec_register(&led_task);
 
 }
+
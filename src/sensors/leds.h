@@ -16,11 +16,14 @@
 #define __LEDS_H__
 
 #include "commons.h"
+#include "gpio_bank.h"
+#include "executive.h"
 
 #define LED0_NODE DT_ALIAS(led0)
 #define LED1_NODE DT_ALIAS(led1)
 #define LED2_NODE DT_ALIAS(led2)
 #define LED3_NODE DT_ALIAS(led3)
+#define N_LEDS 4
 #define ERR_RDY -1
 
 /**
@@ -29,39 +32,54 @@
  * This function initializes and configures the GPIO pins corresponding to the
  * LEDs on the Nordic Board. It checks the readiness of each LED device and
  * configures them as GPIO outputs with an initial inactive state. Additionally,
- * it creates a thread (`thread_led_set_code`) to control the state of LEDs
- * periodically.
+ * it registers a task (`task_led_set_code`) with the executive (see executive.h)
+ * to control the state of LEDs periodically.
  *
  * @return int
  * - Returns 0 on success.
  * - Returns ERR_RDY (-1) if any LED device is not ready.
  *
- * @note Ensure that LED devices (led_0, led_1, led_2, led_3) are properly defined
- *       and initialized before calling this function.
- * @note The created thread (`thread_led_set_code`) should manage LED states
+ * @note The LEDs (aliases led0 to led3) are configured as a single GPIO bank
+ *       (see gpio_bank.h), so they are written with one access per port.
+ * @note The registered task (`task_led_set_code`) manages LED states
  *       based on the configuration set by this function.
  */
 int configure_leds(void);
 
 /**
- * @brief Thread function for setting LED states periodically.
+ * @brief Drives the LED GPIOs directly.
  *
- * This thread function continuously reads the state of LEDs from the real-time
- * database (RTDB) and sets the corresponding GPIO pins to control the LEDs.
- * It measures the execution time of the LED setting process and operates in a
- * periodic manner based on the specified thread_led_period.
+ * Used by the PWM LED engine (see pwm_leds.h) for its software PWM. LEDs that
+ * are not under PWM control are overwritten by the LED task on its next
+ * activation.
  *
- * @param argA Unused parameter.
- * @param argB Unused parameter.
- * @param argC Unused parameter.
+ * @param mask LEDs to update (bit i is LED i).
+ * @param values Levels to set (bit i is LED i).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns a negative error code if a GPIO port could not be written.
+ */
+int leds_output(uint32_t mask, uint32_t values);
+
+/**
+ * @brief Task for setting LED states periodically.
+ *
+ * Run periodically by the executive, this job reads the state of LEDs from the
+ * real-time database (RTDB) and sets the corresponding GPIO pins to control the
+ * LEDs. LEDs under PWM control (see pwm_leds.h) are left untouched, LEDs
+ * wired to a PWM channel are set through it (0 or 100 % duty).
+ *
+ * The RTDB is read as one snapshot (rtdb_read_leds()) and written with one
+ * gpio_bank_write(), so the LEDs of an RTDB transaction change together
+ * (in the same port write when they share a GPIO port).
  *
  * @note Ensure that GPIO pins and RTDB are properly configured and initialized
- *       before starting this thread (`thread_led_set_code`).
- * @note The thread periodicity (thread_led_period) should be properly configured to
+ *       before the executive is started.
+ * @note The task periodicity (thread_led_period) should be properly configured to
  *       avoid overrun or underrun.
  *
  */
-void thread_led_set_code(void *argA, void *argB, void *argC);
+void task_led_set_code(void);
 
 #endif
-
@@ -0,0 +1,245 @@
+/**
+ * @file pwm_leds.c
+ * @brief PWM LED engine with brightness levels and autonomous blink patterns.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "pwm_leds.h"
+#include "leds.h"
+
+#if defined(CONFIG_PWM)
+/* LEDs with a PWM channel in the devicetree, the others use software PWM */
+static const struct pwm_dt_spec pwm_led_hw[N_LEDS] = {
+#if DT_HAS_ALIAS(pwm_led0)
+    [0] = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led0)),
+#endif
+#if DT_HAS_ALIAS(pwm_led1)
+    [1] = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led1)),
+#endif
+#if DT_HAS_ALIAS(pwm_led2)
+    [2] = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led2)),
+#endif
+#if DT_HAS_ALIAS(pwm_led3)
+    [3] = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led3)),
+#endif
+};
+#endif
+
+/**
+ * @struct pwm_led_t
+ *
+ * @brief Runtime state of a PWM LED.
+ */
+struct pwm_led_t {
+    struct pwm_led_cfg_t cfg;
+    struct k_timer step_timer;  /* Advances the pattern */
+    struct k_timer soft_timer;  /* Software PWM carrier */
+    uint8_t step;               /* Current pattern step */
+    uint8_t duty_now;           /* Brightness currently on the output */
+    uint8_t soft_on;            /* Current level of the software PWM carrier */
+};
+
+static struct pwm_led_t pwm_led[N_LEDS];
+static atomic_t pwm_active_mask = ATOMIC_INIT(0);
+static atomic_t pwm_driven_mask = ATOMIC_INIT(0);  /* Outputs changed since pwm_leds_take_driven() */
+static uint32_t pwm_hw_mask;                        /* LEDs with a PWM channel, set at init */
+
+/* Serializes configuration changes (thread) with the playback timers (ISR) */
+static struct k_spinlock pwm_lock;
+
+/* Drives the output of an LED with the given brightness. Called with pwm_lock held. */
+static void pwm_led_output(int id, int duty) {
+
+    struct pwm_led_t *led = &pwm_led[id];
+    led->duty_now = duty;
+    atomic_or(&pwm_driven_mask, BIT(id));
+
+#if defined(CONFIG_PWM)
+    if(led->cfg.hw) {
+        /* The PWM peripheral keeps the brightness by itself */
+        const struct pwm_dt_spec *spec = &pwm_led_hw[id];
+        pwm_set_pulse_dt(spec, (uint32_t)(((uint64_t)spec->period * duty) / 100));
+        return;
+    }
+#endif
+
+    /* Software PWM, full on/off levels need no carrier */
+    k_timer_stop(&led->soft_timer);
+    if(duty == 0 || duty == 100) {
+        leds_output(BIT(id), duty ? BIT(id) : 0);
+    } else {
+        led->soft_on = 1;
+        leds_output(BIT(id), BIT(id));
+        k_timer_start(&led->soft_timer, K_USEC(PWM_LED_SOFT_PERIOD_US * duty / 100), K_NO_WAIT);
+    }
+}
+
+/* Applies the current pattern step. Called with pwm_lock held. */
+static void pwm_led_apply_step(int id) {
+    struct pwm_led_t *led = &pwm_led[id];
+    int duty = ((led->cfg.pattern >> led->step) & 1) ? led->cfg.duty : 0;
+
+    /* Steps with the same level as the previous one leave the output untouched */
+    if(duty != led->duty_now) {
+        pwm_led_output(id, duty);
+    }
+}
+
+/* (Re)starts the playback of an LED from its first step. Called with pwm_lock held. */
+static void pwm_led_start(int id) {
+    struct pwm_led_t *led = &pwm_led[id];
+
+    k_timer_stop(&led->step_timer);
+    led->step = 0;
+    pwm_led_output(id, (led->cfg.pattern & 1) ? led->cfg.duty : 0);
+
+    if(led->cfg.mode == PWM_LED_MODE_PATTERN && led->cfg.pattern_len > 1) {
+        k_timer_start(&led->step_timer, K_MSEC(led->cfg.step_ms), K_MSEC(led->cfg.step_ms));
+    }
+}
+
+static void step_timer_expiry(struct k_timer *timer) {
+    struct pwm_led_t *led = CONTAINER_OF(timer, struct pwm_led_t, step_timer);
+    int id = led - pwm_led;
+
+    k_spinlock_key_t key = k_spin_lock(&pwm_lock);
+    led->step = (led->step + 1) % led->cfg.pattern_len;
+    pwm_led_apply_step(id);
+    k_spin_unlock(&pwm_lock, key);
+}
+
+static void soft_timer_expiry(struct k_timer *timer) {
+    struct pwm_led_t *led = CONTAINER_OF(timer, struct pwm_led_t, soft_timer);
+    int id = led - pwm_led;
+
+    k_spinlock_key_t key = k_spin_lock(&pwm_lock);
+    uint32_t on_us = PWM_LED_SOFT_PERIOD_US * led->duty_now / 100;
+    led->soft_on = !led->soft_on;
+    leds_output(BIT(id), led->soft_on ? BIT(id) : 0);
+    k_timer_start(timer, K_USEC(led->soft_on ? on_us : PWM_LED_SOFT_PERIOD_US - on_us), K_NO_WAIT);
+    k_spin_unlock(&pwm_lock, key);
+}
+
+int pwm_leds_init(void) {
+
+    for(int i = 0; i < N_LEDS; i++) {
+        struct pwm_led_t *led = &pwm_led[i];
+
+        led->cfg.mode = PWM_LED_MODE_GPIO;
+        led->cfg.duty = 100;
+        led->cfg.pattern = 1;
+        led->cfg.pattern_len = 1;
+        led->cfg.step_ms = PWM_LED_STEP_MIN_MS;
+        led->cfg.hw = 0;
+#if defined(CONFIG_PWM)
+        if(pwm_led_hw[i].dev != NULL && pwm_is_ready_dt(&pwm_led_hw[i])) {
+            led->cfg.hw = 1;
+            pwm_hw_mask |= BIT(i);
+        }
+#endif
+        k_timer_init(&led->step_timer, step_timer_expiry, NULL);
+        k_timer_init(&led->soft_timer, soft_timer_expiry, NULL);
+    }
+
+    return 0;
+}
+
+int pwm_leds_set_duty(int id, int duty) {
+
+    if(id < 0 || id >= N_LEDS || duty < 0 || duty > 100) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&pwm_lock);
+    struct pwm_led_t *led = &pwm_led[id];
+    led->cfg.duty = duty;
+    if(led->cfg.mode != PWM_LED_MODE_PATTERN) {
+        led->cfg.mode = PWM_LED_MODE_STEADY;
+        led->cfg.pattern = 1;
+        led->cfg.pattern_len = 1;
+    }
+    atomic_or(&pwm_active_mask, BIT(id));
+    pwm_led_start(id);
+    k_spin_unlock(&pwm_lock, key);
+
+    return 0;
+}
+
+int pwm_leds_set_blink(int id, int period_ms) {
+    if(period_ms % 2) {
+        period_ms++;
+    }
+    return pwm_leds_set_pattern(id, 0x1, 2, period_ms / 2);
+}
+
+int pwm_leds_set_pattern(int id, uint16_t pattern, int len, int step_ms) {
+
+    if(id < 0 || id >= N_LEDS || len < 1 || len > PWM_LED_PATTERN_MAX ||
+       step_ms < PWM_LED_STEP_MIN_MS || step_ms > PWM_LED_STEP_MAX_MS) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&pwm_lock);
+    struct pwm_led_t *led = &pwm_led[id];
+    led->cfg.mode = PWM_LED_MODE_PATTERN;
+    led->cfg.pattern = pattern;
+    led->cfg.pattern_len = len;
+    led->cfg.step_ms = step_ms;
+    atomic_or(&pwm_active_mask, BIT(id));
+    pwm_led_start(id);
+    k_spin_unlock(&pwm_lock, key);
+
+    return 0;
+}
+
+void pwm_leds_release(int id) {
+
+    k_spinlock_key_t key = k_spin_lock(&pwm_lock);
+    struct pwm_led_t *led = &pwm_led[id];
+    if(led->cfg.mode != PWM_LED_MODE_GPIO) {
+        k_timer_stop(&led->step_timer);
+        pwm_led_output(id, 0);
+        k_timer_stop(&led->soft_timer);
+        led->cfg.mode = PWM_LED_MODE_GPIO;
+        atomic_and(&pwm_active_mask, ~BIT(id));
+    }
+    k_spin_unlock(&pwm_lock, key);
+}
+
+void pwm_leds_get(int id, struct pwm_led_cfg_t *cfg) {
+    k_spinlock_key_t key = k_spin_lock(&pwm_lock);
+    *cfg = pwm_led[id].cfg;
+    k_spin_unlock(&pwm_lock, key);
+}
+
+uint32_t pwm_leds_active_mask(void) {
+    return atomic_get(&pwm_active_mask);
+}
+
+uint32_t pwm_leds_hw_mask(void) {
+    return pwm_hw_mask;
+}
+
+uint32_t pwm_leds_take_driven(void) {
+    return atomic_clear(&pwm_driven_mask);
+}
+
+int pwm_leds_write_level(uint32_t mask, uint32_t values) {
+
+    int ret = 0;
+#if defined(CONFIG_PWM)
+    for(uint32_t m = mask & pwm_hw_mask; m; m &= m - 1) {
+        int id = find_lsb_set(m) - 1;
+        const struct pwm_dt_spec *spec = &pwm_led_hw[id];
+        int err = pwm_set_pulse_dt(spec, (values & BIT(id)) ? spec->period : 0);
+        if(err && ret == 0) {
+            ret = err;
+        }
+    }
+#endif
+    return ret;
+}
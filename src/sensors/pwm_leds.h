@@ -0,0 +1,165 @@
+/**
+ * @file pwm_leds.h
+ * @brief PWM LED engine with brightness levels and autonomous blink patterns.
+ *
+ * This header file declares an LED mode in which each LED has a brightness
+ * (duty cycle) and an optional on/off pattern. Once loaded, the pattern is
+ * played back by timers, without any task or UART involvement.
+ *
+ * LEDs with a `pwm-ledN` devicetree alias are driven by the PWM API (the
+ * brightness is kept by the PWM peripheral). The remaining LEDs, e.g. on
+ * emulated targets, fall back to a timer-driven software PWM on their GPIO.
+ *
+ * While an LED is under PWM control the LED task does not touch its GPIO.
+ * Control is given back with pwm_leds_release().
+ *
+ * The pin of an LED with a PWM channel stays connected to the PWM peripheral,
+ * released or not (on nRF the GPIO cannot drive a pin owned by a PWM
+ * instance). Its binary level is set through the channel instead, as a 0 or
+ * 100 % duty (pwm_leds_write_level()).
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __PWM_LEDS_H__
+#define __PWM_LEDS_H__
+
+#include "commons.h"
+#include <zephyr/drivers/pwm.h>
+
+#define PWM_LED_PATTERN_MAX 16          /* Max steps of a pattern */
+#define PWM_LED_STEP_MIN_MS 10          /* Shortest pattern step */
+#define PWM_LED_STEP_MAX_MS 10000       /* Longest pattern step */
+#define PWM_LED_SOFT_PERIOD_US 10000    /* Carrier period of the software PWM (100 Hz) */
+
+/* LED modes */
+#define PWM_LED_MODE_GPIO 0     /* Binary, driven by the LED task from the RTDB */
+#define PWM_LED_MODE_STEADY 1   /* Constant brightness */
+#define PWM_LED_MODE_PATTERN 2  /* Pattern played back at the configured brightness */
+
+/**
+ * @struct pwm_led_cfg_t
+ *
+ * @brief Configuration of a PWM LED.
+ *
+ * The pattern is played LSB first: step i is on when bit i is set, and lasts
+ * step_ms. The pattern repeats forever.
+ */
+struct pwm_led_cfg_t {
+    uint8_t mode;           /* PWM_LED_MODE_* */
+    uint8_t duty;           /* Brightness, 0-100 % */
+    uint8_t pattern_len;    /* Number of steps, 1-PWM_LED_PATTERN_MAX */
+    uint16_t pattern;       /* On/off sequence */
+    uint16_t step_ms;       /* Duration of each step */
+    uint8_t hw;             /* 1 if driven by a PWM peripheral, 0 if software PWM */
+};
+
+/**
+ * @brief Initializes the PWM LED engine.
+ *
+ * Must be called after the LED GPIOs are configured. All LEDs start in
+ * PWM_LED_MODE_GPIO.
+ *
+ * @return int
+ * - Returns 0 on success.
+ */
+int pwm_leds_init(void);
+
+/**
+ * @brief Sets the brightness of an LED.
+ *
+ * An LED in PWM_LED_MODE_GPIO switches to a constant brightness, an LED
+ * playing a pattern keeps playing it at the new brightness.
+ *
+ * @param id ID of the LED (0-3).
+ * @param duty Brightness in % (0-100).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if an argument is out of range.
+ */
+int pwm_leds_set_duty(int id, int duty);
+
+/**
+ * @brief Blinks an LED with a 50 % on/off ratio at its current brightness.
+ *
+ * @param id ID of the LED (0-3).
+ * @param period_ms Blink period in ms (2*PWM_LED_STEP_MIN_MS to 2*PWM_LED_STEP_MAX_MS).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if an argument is out of range.
+ */
+int pwm_leds_set_blink(int id, int period_ms);
+
+/**
+ * @brief Loads a pattern on an LED, played at its current brightness.
+ *
+ * @param id ID of the LED (0-3).
+ * @param pattern On/off sequence, LSB first.
+ * @param len Number of steps (1-PWM_LED_PATTERN_MAX).
+ * @param step_ms Duration of each step (PWM_LED_STEP_MIN_MS to PWM_LED_STEP_MAX_MS).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if an argument is out of range.
+ */
+int pwm_leds_set_pattern(int id, uint16_t pattern, int len, int step_ms);
+
+/**
+ * @brief Stops PWM control of an LED and gives it back to the LED task.
+ *
+ * @param id ID of the LED (0-3).
+ */
+void pwm_leds_release(int id);
+
+/**
+ * @brief Reads the configuration of an LED.
+ *
+ * @param id ID of the LED (0-3).
+ * @param cfg Pointer to store the configuration.
+ */
+void pwm_leds_get(int id, struct pwm_led_cfg_t *cfg);
+
+/**
+ * @brief Returns the LEDs currently under PWM control.
+ *
+ * @return uint32_t Bit mask, bit i set if LED i is not in PWM_LED_MODE_GPIO.
+ */
+uint32_t pwm_leds_active_mask(void);
+
+/**
+ * @brief Returns the LEDs driven by a PWM peripheral.
+ *
+ * @return uint32_t Bit mask, bit i set if LED i has a PWM channel.
+ */
+uint32_t pwm_leds_hw_mask(void);
+
+/**
+ * @brief Sets the binary level of LEDs driven by a PWM peripheral.
+ *
+ * Used by the LED task in place of the GPIO for these LEDs.
+ *
+ * @param mask LEDs to update (bit i is LED i), LEDs without a PWM channel are ignored.
+ * @param values Levels to set (bit i is LED i).
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns a negative error code if a PWM channel could not be set.
+ */
+int pwm_leds_write_level(uint32_t mask, uint32_t values);
+
+/**
+ * @brief Returns the LEDs whose output the engine changed since the last call, and clears them.
+ *
+ * Lets the LED task rewrite an LED released since its last activation, whose
+ * output no longer holds the level the task wrote.
+ *
+ * @return uint32_t Bit mask, bit i set if the output of LED i was changed.
+ */
+uint32_t pwm_leds_take_driven(void);
+
+#endif
@@ -0,0 +1,328 @@
+/**
+ * @file replay.c
+ * @brief Recording and deterministic replay of the sensor inputs.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "replay.h"
+#include <zephyr/logging/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(app_replay, CONFIG_APP_REPLAY_LOG_LEVEL);
+
+#if defined(CONFIG_NATIVE_LIBRARY)
+#include "cmdline.h"
+#include "posix_native_task.h"
+#include "replay_host.h"
+#endif
+
+/* Flash-resident trace, replayed when no trace file is given */
+static const struct replay_rec_t replay_table[] = {
+#include "replay_table.inc"
+};
+
+/* Trace replayed, records in time order */
+static const struct replay_rec_t *replay_trace = replay_table;
+static uint32_t replay_total = ARRAY_SIZE(replay_table);
+static const char *replay_source = "TABLE";
+
+static bool replay_playing;
+static int64_t replay_start_ms;
+static uint32_t replay_pos;             /* Records of the trace reached */
+static uint16_t replay_adc_value;
+static uint32_t replay_buttons_value;
+
+/* Recorder */
+static struct replay_rec_t replay_recs[CONFIG_APP_REPLAY_MAX_RECORDS];
+static uint32_t replay_n_recs;
+static uint32_t replay_lost;
+static bool replay_recording;
+static int64_t replay_record_start_ms;
+static int32_t replay_last_adc;
+static int32_t replay_last_buttons;
+
+/* Serializes the tasks (inputs) and the command threads (control) */
+static K_MUTEX_DEFINE(replay_lock);
+
+#if defined(CONFIG_NATIVE_LIBRARY)
+static char *replay_file;
+static char *record_file;
+
+/* Text of a trace file, loaded at boot and reused to write the recording */
+static char replay_text[CONFIG_APP_REPLAY_MAX_RECORDS * REPLAY_LINE_SIZE];
+static struct replay_rec_t replay_loaded[CONFIG_APP_REPLAY_MAX_RECORDS];
+
+static void replay_native_options(void) {
+    static struct args_struct_t replay_options[] = {
+        { .option = "replay-file", .name = "path", .type = 's', .dest = (void *)&replay_file,
+          .descript = "Sensor trace replayed from boot (see replay.h)" },
+        { .option = "record-file", .name = "path", .type = 's', .dest = (void *)&record_file,
+          .descript = "File the sensor inputs are recorded to, from boot to exit" },
+        ARG_TABLE_ENDMARKER
+    };
+    native_add_command_line_opts(replay_options);
+}
+NATIVE_TASK(replay_native_options, PRE_BOOT_1, 1);
+
+/* Parses a text trace, returns the number of records or a negative error code */
+static int replay_parse(const char *text, struct replay_rec_t *recs, int max) {
+
+    int n = 0;
+    int line = 1;
+    uint32_t prev_t = 0;
+
+    for(const char *p = text; *p; line++) {
+        const char *eol = strchr(p, '\n');
+        char *q;
+
+        while(*p == ' ' || *p == '\t' || *p == '\r') {
+            p++;
+        }
+        if(*p != '#' && p != eol && *p) {
+            /* strtoul() would skip whitespace (newlines included) and take a sign:
+               both numbers must start with a digit */
+            unsigned long t = strtoul(p, &q, 10);
+            bool ok = *p >= '0' && *p <= '9';
+            while(*q == ' ' || *q == '\t') {
+                q++;
+            }
+            char input = *q;
+            if(input) {
+                q++;
+            }
+            while(*q == ' ' || *q == '\t') {
+                q++;
+            }
+            const char *v_start = q;
+            ok = ok && *v_start >= '0' && *v_start <= '9';
+            unsigned long value = strtoul(v_start, &q, 10);
+            ok = ok && t >= prev_t &&
+                 ((input == REPLAY_ADC && value <= 1023) || (input == REPLAY_BUTTONS && value <= 0xFFFF));
+            if(!ok) {
+                LOG_ERR("trace line %d: expected '<t_ms> A|B <value>' in time order", line);
+                return -EINVAL;
+            }
+            if(n == max) {
+                LOG_ERR("trace longer than CONFIG_APP_REPLAY_MAX_RECORDS (%d)", max);
+                return -ENOMEM;
+            }
+            recs[n++] = (struct replay_rec_t){ .t_ms = t, .value = value, .input = input };
+            prev_t = t;
+        }
+        if(!eol) {
+            break;
+        }
+        p = eol + 1;
+    }
+    return n;
+}
+
+/* Writes the recording to --record-file */
+static void replay_native_save(void) {
+
+    if(record_file == NULL) {
+        return;
+    }
+
+    size_t len = snprintf(replay_text, sizeof(replay_text), "# SMART_IO sensor trace, lost records: %u\n",
+                          (unsigned int)replay_lost);
+    for(uint32_t i = 0; i < replay_n_recs && len + REPLAY_LINE_SIZE <= sizeof(replay_text); i++) {
+        len += replay_format(&replay_recs[i], &replay_text[len]);
+    }
+    if(replay_host_write(record_file, replay_text, len) < 0) {
+        LOG_ERR("cannot write %s", record_file);
+    }
+}
+
+/* The simulation may end at any time (e.g. --stop_at), the recording is saved on exit */
+static void replay_native_exit(void) {
+    if(replay_recording) {
+        replay_native_save();
+    }
+}
+NATIVE_TASK(replay_native_exit, ON_EXIT_PRE, 1);
+#endif
+
+int replay_init(void) {
+
+#if defined(CONFIG_NATIVE_LIBRARY)
+    if(replay_file != NULL) {
+        long len = replay_host_read(replay_file, replay_text, sizeof(replay_text) - 1);
+        if(len < 0) {
+            LOG_ERR("cannot read %s", replay_file);
+            return -ENOENT;
+        }
+        replay_text[len] = '\0';
+
+        int n = replay_parse(replay_text, replay_loaded, ARRAY_SIZE(replay_loaded));
+        if(n < 0) {
+            return n;
+        }
+        replay_trace = replay_loaded;
+        replay_total = n;
+        replay_source = "FILE";
+        LOG_INF("replaying %d records from %s", n, replay_file);
+        replay_start();
+    }
+    if(record_file != NULL) {
+        replay_record_start();
+    }
+#endif
+    return 0;
+}
+
+int replay_start(void) {
+
+    if(replay_total == 0) {
+        return -ENOENT;
+    }
+
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    replay_start_ms = k_uptime_get();
+    replay_pos = 0;
+    replay_adc_value = 0;
+    replay_buttons_value = 0;
+    replay_playing = true;
+    k_mutex_unlock(&replay_lock);
+    return 0;
+}
+
+void replay_stop(void) {
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    replay_playing = false;
+    k_mutex_unlock(&replay_lock);
+}
+
+/* Applies the records reached by now, replay_lock must be held */
+static void replay_advance(void) {
+    int64_t now = k_uptime_get();
+    while(replay_pos < replay_total && replay_start_ms + replay_trace[replay_pos].t_ms <= now) {
+        const struct replay_rec_t *rec = &replay_trace[replay_pos++];
+        if(rec->input == REPLAY_ADC) {
+            replay_adc_value = rec->value;
+        } else {
+            replay_buttons_value = rec->value;
+        }
+    }
+}
+
+bool replay_adc(uint16_t *raw) {
+
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    bool playing = replay_playing;
+    if(playing) {
+        replay_advance();
+        *raw = replay_adc_value;
+    }
+    k_mutex_unlock(&replay_lock);
+    return playing;
+}
+
+bool replay_buttons(uint32_t *values) {
+
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    bool playing = replay_playing;
+    if(playing) {
+        replay_advance();
+        *values = replay_buttons_value;
+    }
+    k_mutex_unlock(&replay_lock);
+    return playing;
+}
+
+int64_t replay_next_buttons_ms(void) {
+
+    int64_t next = -1;
+
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    if(replay_playing) {
+        for(uint32_t i = replay_pos; i < replay_total; i++) {
+            if(replay_trace[i].input == REPLAY_BUTTONS) {
+                next = replay_start_ms + replay_trace[i].t_ms;
+                break;
+            }
+        }
+    }
+    k_mutex_unlock(&replay_lock);
+    return next;
+}
+
+void replay_record_start(void) {
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    replay_n_recs = 0;
+    replay_lost = 0;
+    replay_last_adc = -1;
+    replay_last_buttons = -1;
+    replay_record_start_ms = k_uptime_get();
+    replay_recording = true;
+    k_mutex_unlock(&replay_lock);
+}
+
+void replay_record_stop(void) {
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    replay_recording = false;
+#if defined(CONFIG_NATIVE_LIBRARY)
+    replay_native_save();
+#endif
+    k_mutex_unlock(&replay_lock);
+}
+
+void replay_record(uint8_t input, uint16_t value) {
+
+    if(!replay_recording) {
+        return;
+    }
+
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    int32_t *last = (input == REPLAY_ADC) ? &replay_last_adc : &replay_last_buttons;
+    if(replay_recording && *last != value) {
+        *last = value;
+        if(replay_n_recs < ARRAY_SIZE(replay_recs)) {
+            replay_recs[replay_n_recs++] = (struct replay_rec_t){
+                .t_ms = (uint32_t)(k_uptime_get() - replay_record_start_ms),
+                .value = value,
+                .input = input,
+            };
+        } else {
+            replay_lost++;
+        }
+    }
+    k_mutex_unlock(&replay_lock);
+}
+
+void replay_info_get(struct replay_info_t *info) {
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    if(replay_playing) {
+        replay_advance();
+    }
+    info->playing = replay_playing;
+    info->recording = replay_recording;
+    info->source = replay_source;
+    info->played = replay_pos;
+    info->total = replay_total;
+    info->recorded = replay_n_recs;
+    info->lost = replay_lost;
+    k_mutex_unlock(&replay_lock);
+}
+
+int replay_recorded_get(uint32_t idx, struct replay_rec_t *rec) {
+
+    k_mutex_lock(&replay_lock, K_FOREVER);
+    int ret = -EINVAL;
+    if(idx < replay_n_recs) {
+        *rec = replay_recs[idx];
+        ret = 0;
+    }
+    k_mutex_unlock(&replay_lock);
+    return ret;
+}
+
+int replay_format(const struct replay_rec_t *rec, char *buf) {
+    return snprintf(buf, REPLAY_LINE_SIZE, "%u %c %u\n", (unsigned int)rec->t_ms, rec->input, (unsigned int)rec->value);
+}
@@ -0,0 +1,186 @@
+/**
+ * @file replay.h
+ * @brief Recording and deterministic replay of the sensor inputs.
+ *
+ * This header file declares a replay source, enabled with CONFIG_APP_REPLAY,
+ * that feeds a trace of timestamped inputs to the acquisition paths in place
+ * of the hardware: adc_sample() and the ADC task take the ADC value of the
+ * trace, the button task takes its button states. Everything after the read
+ * (range checks, RTDB, gestures, events) runs as with live inputs, so runs
+ * with the same trace are repeatable across firmware versions.
+ *
+ * A trace is a list of records, each giving the value an input takes from a
+ * time on (ms since the start of the trace) until the next record of the same
+ * input. As text, one record per line:
+ *
+ *     <t_ms> A <raw ADC value, 0-1023>
+ *     <t_ms> B <button states, bit i set when button i is pressed>
+ *
+ * Lines starting with '#' are comments. The trace replayed is the one given
+ * with --replay-file on native_sim (replay starts at boot), otherwise the
+ * flash-resident table in replay_table.inc (generated with
+ * tools/replay/replay_trace.py). The recorder logs every change of the live
+ * (or replayed) inputs in the same format; the recording is dumped over the
+ * UART with the 'YD' command and, on native_sim, written to --record-file
+ * when it stops.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <zephyr/kernel.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Inputs */
+#define REPLAY_ADC 'A'
+#define REPLAY_BUTTONS 'B'
+
+#define REPLAY_LINE_SIZE 24     /* Longest text record, terminator included */
+
+/**
+ * @struct replay_rec_t
+ *
+ * @brief Trace record: value taken by an input from t_ms on.
+ */
+struct replay_rec_t {
+    uint32_t t_ms;
+    uint16_t value;
+    uint8_t input;      /* REPLAY_ADC or REPLAY_BUTTONS */
+};
+
+/**
+ * @struct replay_info_t
+ *
+ * @brief State of the replay source and of the recorder.
+ */
+struct replay_info_t {
+    bool playing;
+    bool recording;
+    const char *source;     /* "FILE" or "TABLE" */
+    uint32_t played;        /* Records of the trace reached */
+    uint32_t total;         /* Records of the trace */
+    uint32_t recorded;      /* Records held by the recorder */
+    uint32_t lost;          /* Records not recorded, recorder full */
+};
+
+/**
+ * @brief Starts replaying the trace from its beginning.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -ENOENT if the trace is empty.
+ */
+int replay_start(void);
+
+/**
+ * @brief Stops replaying, the inputs are read from the hardware again.
+ */
+void replay_stop(void);
+
+/**
+ * @brief Starts recording, the previous recording is discarded.
+ */
+void replay_record_start(void);
+
+/**
+ * @brief Stops recording.
+ *
+ * On native_sim the recording is written to --record-file, if given.
+ */
+void replay_record_stop(void);
+
+/**
+ * @brief Gets the state of the replay source and of the recorder.
+ *
+ * @param info Destination.
+ */
+void replay_info_get(struct replay_info_t *info);
+
+/**
+ * @brief Gets a record of the recording.
+ *
+ * @param idx Record index, 0 is the oldest.
+ * @param rec Destination.
+ *
+ * @return int 0 on success, -EINVAL if idx is out of range.
+ */
+int replay_recorded_get(uint32_t idx, struct replay_rec_t *rec);
+
+/**
+ * @brief Formats a record as a text line ("<t_ms> <input> <value>\n").
+ *
+ * @param rec Record.
+ * @param buf Destination, REPLAY_LINE_SIZE bytes.
+ *
+ * @return int Length of the line.
+ */
+int replay_format(const struct replay_rec_t *rec, char *buf);
+
+/* Hooks of main() and of the acquisition paths, no-ops without CONFIG_APP_REPLAY */
+#if defined(CONFIG_APP_REPLAY)
+
+/**
+ * @brief Loads the trace and starts replay and recording if requested.
+ *
+ * On native_sim, loads the --replay-file trace and starts replaying it, and
+ * starts recording if --record-file is given. To be called just before the
+ * executive starts, so that the trace time matches the task releases.
+ *
+ * @return int 0 on success, a negative error code if the trace file is invalid.
+ */
+int replay_init(void);
+
+/**
+ * @brief Gets the replayed ADC value.
+ *
+ * @param raw Set to the value of the trace at the current time.
+ *
+ * @return bool True when replaying (raw is set), false to read the ADC.
+ */
+bool replay_adc(uint16_t *raw);
+
+/**
+ * @brief Gets the replayed button states.
+ *
+ * @param values Set to the button states of the trace at the current time.
+ *
+ * @return bool True when replaying (values is set), false to read the buttons.
+ */
+bool replay_buttons(uint32_t *values);
+
+/**
+ * @brief Uptime of the next change of the replayed button states.
+ *
+ * Lets the button task, when it only runs on edges, run at the edges of the
+ * trace.
+ *
+ * @return int64_t Uptime in ms, or -1 if not replaying or no change is left.
+ */
+int64_t replay_next_buttons_ms(void);
+
+/**
+ * @brief Records the value of an input if it changed.
+ *
+ * @param input REPLAY_ADC or REPLAY_BUTTONS.
+ * @param value Value read.
+ */
+void replay_record(uint8_t input, uint16_t value);
+
+#else
+
+static inline int replay_init(void) { return 0; }
+static inline bool replay_adc(uint16_t *raw) { return false; }
+static inline bool replay_buttons(uint32_t *values) { return false; }
+static inline int64_t replay_next_buttons_ms(void) { return -1; }
+static inline void replay_record(uint8_t input, uint16_t value) { }
+
+#endif
+
+#endif
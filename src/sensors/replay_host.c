@@ -0,0 +1,32 @@
+/**
+ * @file replay_host.c
+ * @brief Host side file access of the sensor replay (native_sim only).
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "replay_host.h"
+#include <stdio.h>
+
+long replay_host_read(const char *path, char *buf, long size) {
+    FILE *f = fopen(path, "r");
+    if(f == NULL) {
+        return -1;
+    }
+    long len = fread(buf, 1, size, f);
+    fclose(f);
+    return len;
+}
+
+long replay_host_write(const char *path, const char *buf, long len) {
+    FILE *f = fopen(path, "w");
+    if(f == NULL) {
+        return -1;
+    }
+    long written = fwrite(buf, 1, len, f);
+    fclose(f);
+    return written == len ? written : -1;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file replay_host.h
+ * @brief Host side file access of the sensor replay (native_sim only).
+ *
+ * Built into the native simulator runner with the host C library, called by
+ * replay.c to read a trace file and to write a recording.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __REPLAY_HOST_H__
+#define __REPLAY_HOST_H__
+
+/**
+ * @brief Reads a host file.
+ *
+ * @param path File path.
+ * @param buf Destination.
+ * @param size Size of buf.
+ *
+ * @return long Bytes read (at most size), -1 if the file cannot be read.
+ */
+long replay_host_read(const char *path, char *buf, long size);
+
+/**
+ * @brief Creates or overwrites a host file.
+ *
+ * @param path File path.
+ * @param buf Contents.
+ * @param len Length of the contents.
+ *
+ * @return long Bytes written, -1 on error.
+ */
+long replay_host_write(const char *path, const char *buf, long len);
+
+#endif
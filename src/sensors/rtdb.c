@@ -1,62 +1,140 @@
 
 #include "rtdb.h"
+#include "../diag/trace.h"
+#include "../config/persist.h"
 
 
-int leds[4];
-int buttons[4];
-int adc_raw;
-int adc_an_val;
+static int leds[4];
+static int buttons[4];
+static int adc_raw;
+static int adc_an_val;
 
-struct k_mutex leds_mutex[4];
-struct k_mutex buttons_mutex[4];
-struct k_mutex adc_raw_mutex;
-struct k_mutex adc_an_mutex;
+/* One lock per signal group: an LED transaction or snapshot takes a single lock */
+static K_MUTEX_DEFINE(leds_mutex);
+static K_MUTEX_DEFINE(buttons_mutex);
+static K_MUTEX_DEFINE(adc_mutex);
+
+static void (*led_listener)(uint32_t mask) = NULL;
 
 void rtdb_read_adc_raw(int *res) {
-	k_mutex_lock(&adc_raw_mutex, K_FOREVER);
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_ADC_RAW, 0, 0));
+	k_mutex_lock(&adc_mutex, K_FOREVER);
 	*res = adc_raw;
-	k_mutex_unlock(&adc_raw_mutex);
+	k_mutex_unlock(&adc_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_ADC_RAW, 0, 0));
 }
 
 void rtdb_read_adc_an(int *res) {
-	k_mutex_lock(&adc_an_mutex, K_FOREVER);
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_ADC_AN, 0, 0));
+	k_mutex_lock(&adc_mutex, K_FOREVER);
 	*res = adc_an_val;
-	k_mutex_unlock(&adc_an_mutex);
+	k_mutex_unlock(&adc_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_ADC_AN, 0, 0));
 }
 
 void rtdb_read_led(int id, int *res) {
-	k_mutex_lock(&leds_mutex[id], K_FOREVER);
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_LED, id, 0));
+	k_mutex_lock(&leds_mutex, K_FOREVER);
 	*res = leds[id];
-	k_mutex_unlock(&leds_mutex[id]);
+	k_mutex_unlock(&leds_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_LED, id, 0));
+}
+
+void rtdb_read_leds(uint32_t *values) {
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_LED, TRACE_RTDB_ALL, 0));
+	k_mutex_lock(&leds_mutex, K_FOREVER);
+	*values = 0;
+	for(int i = 0; i < ARRAY_SIZE(leds); i++) {
+		if(leds[i]) {
+			*values |= BIT(i);
+		}
+	}
+	k_mutex_unlock(&leds_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_LED, TRACE_RTDB_ALL, 0));
 }
 
 void rtdb_read_button(int id, int *res) {
-	k_mutex_lock(&buttons_mutex[id], K_FOREVER);
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_BUTTON, id, 0));
+	k_mutex_lock(&buttons_mutex, K_FOREVER);
 	*res = buttons[id];
-	k_mutex_unlock(&buttons_mutex[id]);
+	k_mutex_unlock(&buttons_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_BUTTON, id, 0));
 }
 
 void rtdb_set_adc_raw(int value) {
-	k_mutex_lock(&adc_raw_mutex, K_FOREVER);
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_ADC_RAW, 0, 1));
+	k_mutex_lock(&adc_mutex, K_FOREVER);
 	adc_raw = value;
-	k_mutex_unlock(&adc_raw_mutex);
+	k_mutex_unlock(&adc_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_ADC_RAW, 0, 1));
 }
 
 void rtdb_set_adc_an(int value) {
-	k_mutex_lock(&adc_an_mutex, K_FOREVER);
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_ADC_AN, 0, 1));
+	k_mutex_lock(&adc_mutex, K_FOREVER);
 	adc_an_val = value;
-	k_mutex_unlock(&adc_an_mutex);
+	k_mutex_unlock(&adc_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_ADC_AN, 0, 1));
 }
 void rtdb_set_led(int id, int value) {
-	k_mutex_lock(&leds_mutex[id], K_FOREVER);
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_LED, id, 1));
+	k_mutex_lock(&leds_mutex, K_FOREVER);
 	leds[id] = value;
-	k_mutex_unlock(&leds_mutex[id]);
+	k_mutex_unlock(&leds_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_LED, id, 1));
+
+	if(led_listener != NULL) {
+		led_listener(BIT(id));
+	}
+	persist_touch(PERSIST_LEDS);
+}
+
+void rtdb_leds_txn_begin(struct rtdb_leds_txn_t *txn) {
+	txn->mask = 0;
+	txn->values = 0;
+}
+
+void rtdb_leds_txn_stage(struct rtdb_leds_txn_t *txn, int id, int value) {
+	txn->mask |= BIT(id);
+	if(value) {
+		txn->values |= BIT(id);
+	} else {
+		txn->values &= ~BIT(id);
+	}
+}
+
+void rtdb_leds_txn_commit(const struct rtdb_leds_txn_t *txn) {
+	uint32_t mask = txn->mask & BIT_MASK(ARRAY_SIZE(leds));
+	if(mask == 0) {
+		return;
+	}
+
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_LED, TRACE_RTDB_ALL, 1));
+	k_mutex_lock(&leds_mutex, K_FOREVER);
+	for(int i = 0; i < ARRAY_SIZE(leds); i++) {
+		if(mask & BIT(i)) {
+			leds[i] = (txn->values >> i) & 1;
+		}
+	}
+	k_mutex_unlock(&leds_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_LED, TRACE_RTDB_ALL, 1));
+
+	if(led_listener != NULL) {
+		led_listener(mask);
+	}
+	persist_touch(PERSIST_LEDS);
+}
+
+void rtdb_set_led_listener(void (*listener)(uint32_t mask)) {
+	led_listener = listener;
 }
 
 void rtdb_set_button(int id, int value) {
-	k_mutex_lock(&buttons_mutex[id], K_FOREVER);
+	TRACE(TRACE_EVT_RTDB_LOCK, TRACE_RTDB_ARG(TRACE_RTDB_BUTTON, id, 1));
+	k_mutex_lock(&buttons_mutex, K_FOREVER);
 	buttons[id] = value;
-	k_mutex_unlock(&buttons_mutex[id]);
+	k_mutex_unlock(&buttons_mutex);
+	TRACE(TRACE_EVT_RTDB_UNLOCK, TRACE_RTDB_ARG(TRACE_RTDB_BUTTON, id, 1));
 }
 
 
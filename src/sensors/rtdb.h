@@ -7,6 +7,9 @@
  * responsible for managing and accessing real-time data such as ADC values, LED
  * statuses and button states.
  *
+ * Each signal group (LEDs, buttons, ADC) is protected by its own mutex,
+ * defined statically so that it is usable before any thread runs.
+ *
  * @author Diogo Lapa 117296
  * @author Bruno Duarte 118326
  * @date 04-06-2024
@@ -17,6 +20,19 @@
 
 #include <zephyr/kernel.h>
 
+/**
+ * @struct rtdb_leds_txn_t
+ *
+ * @brief Staged write of several LEDs, applied as a whole by rtdb_leds_txn_commit().
+ *
+ * Owned by the writer: staging does not touch the RTDB, so readers never see
+ * part of a transaction.
+ */
+struct rtdb_leds_txn_t {
+    uint32_t mask;      /* LEDs written by the transaction (bit i is LED i) */
+    uint32_t values;    /* Their new status (bit i is LED i) */
+};
+
 /**
  * @brief Reads the raw ADC value from the RTDB.
  *
@@ -39,6 +55,16 @@ void rtdb_read_adc_an(int *res);
  */
 void rtdb_read_led(int id, int *res);
 
+/**
+ * @brief Reads the status of every LED from the RTDB at once.
+ *
+ * The snapshot is consistent: a transaction committed meanwhile is seen
+ * either completely or not at all.
+ *
+ * @param values Pointer to store the LED statuses (bit i is LED i).
+ */
+void rtdb_read_leds(uint32_t *values);
+
 /**
  * @brief Reads the status of a specific button from the RTDB.
  *
@@ -69,6 +95,35 @@ void rtdb_set_adc_an(int value);
  */
 void rtdb_set_led(int id, int value);
 
+/**
+ * @brief Starts an LED transaction, with no LED staged.
+ *
+ * @param txn Transaction.
+ */
+void rtdb_leds_txn_begin(struct rtdb_leds_txn_t *txn);
+
+/**
+ * @brief Stages the status of an LED in a transaction.
+ *
+ * Staging the same LED again replaces its value.
+ *
+ * @param txn Transaction.
+ * @param id ID of the LED to set (0-3).
+ * @param value Status value to set for the LED.
+ */
+void rtdb_leds_txn_stage(struct rtdb_leds_txn_t *txn, int id, int value);
+
+/**
+ * @brief Writes every LED staged in a transaction in one RTDB update.
+ *
+ * The LED group is locked once for the whole update, and the LED
+ * listener is called once with the mask of the transaction, so the LED driver
+ * applies the whole transaction in the same GPIO update.
+ *
+ * @param txn Transaction, LEDs outside txn->mask are left untouched.
+ */
+void rtdb_leds_txn_commit(const struct rtdb_leds_txn_t *txn);
+
 /**
  * @brief Sets the status of a specific button in the RTDB.
  *
@@ -77,4 +132,15 @@ void rtdb_set_led(int id, int value);
  */
 void rtdb_set_button(int id, int value);
 
+/**
+ * @brief Registers a callback invoked after every LED write.
+ *
+ * Lets the LED driver react to new values instead of polling the RTDB.
+ * The callback runs in the context of the writer, once per rtdb_set_led()
+ * or rtdb_leds_txn_commit().
+ *
+ * @param listener Callback, receives the mask of the LEDs written (bit i is LED i).
+ */
+void rtdb_set_led_listener(void (*listener)(uint32_t mask));
+
 #endif
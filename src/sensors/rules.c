@@ -0,0 +1,310 @@
+/**
+ * @file rules.c
+ * @brief On-device reactive rules linking the inputs to the LEDs.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include "rules.h"
+#include "rtdb.h"
+#include "adc.h"
+#include "leds.h"
+#include "buttons.h"
+#include "events.h"
+#include "pwm_leds.h"
+#include "../config/persist.h"
+#include <stdio.h>
+#include <string.h>
+
+BUILD_ASSERT(CONFIG_APP_RULES_MAX <= 32, "the rule masks are 32-bit");
+
+/* Event letters, indexed by event type */
+static const char rules_event_letters[] = "PRLD";
+
+static struct rule_t rules[CONFIG_APP_RULES_MAX];
+
+/* Rules read by each input (bit i is slot i) */
+static uint32_t rules_adc_mask;
+static uint32_t rules_button_mask[N_BUTTONS];
+static uint32_t rules_event_mask[N_BUTTONS];
+
+/* Serializes the tasks (evaluation) and the command threads (upload) */
+static K_MUTEX_DEFINE(rules_lock);
+
+/**
+ * @struct rules_update_t
+ *
+ * @brief LED changes of the rules evaluated on one input change.
+ */
+struct rules_update_t {
+    struct rtdb_leds_txn_t txn;
+    uint32_t leds;      /* LED statuses, staged changes included */
+};
+
+/* ADC level (mV) to the raw sample bound it stands for: the lowest raw sample
+   at or above it, or the highest at or below it */
+static uint16_t rules_level_raw(int mv, bool above) {
+    int lo = 0, hi = 1024;
+    /* adc_raw_to_mv() is monotonic: find the first raw sample above (or at) mv */
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        if(above ? adc_raw_to_mv(mid) >= mv : adc_raw_to_mv(mid) > mv) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return above ? lo : lo - 1;
+}
+
+/* Applies a rule to the new value of its condition, rules_lock must be held */
+static void rules_apply(struct rule_t *rule, bool cond, struct rules_update_t *upd) {
+
+    /* Events have no duration, every other condition acts on changes only */
+    if(rule->cond != RULE_COND_EVENT) {
+        if(rule->state == cond) {
+            return;
+        }
+        rule->state = cond;
+    }
+
+    bool current = (upd->leds >> rule->led) & 1;
+    bool value;
+    switch(rule->action) {
+        case RULE_ACT_FOLLOW:
+            value = cond;
+            break;
+        case RULE_ACT_INVERT:
+            value = !cond;
+            break;
+        case RULE_ACT_SET:
+        case RULE_ACT_CLEAR:
+        case RULE_ACT_TOGGLE:
+            if(!cond) {
+                return;
+            }
+            value = (rule->action == RULE_ACT_SET) ||
+                    (rule->action == RULE_ACT_TOGGLE && !current);
+            break;
+        default:
+            return;
+    }
+
+    rule->fired++;
+    if(value != current) {
+        rtdb_leds_txn_stage(&upd->txn, rule->led, value);
+        upd->leds ^= BIT(rule->led);
+    }
+}
+
+static bool rules_adc_cond(const struct rule_t *rule, uint16_t raw) {
+    return (rule->op == RULE_ADC_ABOVE) ? raw >= rule->level_raw : raw <= rule->level_raw;
+}
+
+static void rules_update_begin(struct rules_update_t *upd) {
+    rtdb_leds_txn_begin(&upd->txn);
+    rtdb_read_leds(&upd->leds);
+}
+
+/* Commits the LED changes, if any, as one RTDB transaction */
+static void rules_update_commit(struct rules_update_t *upd) {
+    for(uint32_t m = upd->txn.mask; m; m &= m - 1) {
+        /* As a binary LED write, a rule takes the LED back from the PWM engine */
+        pwm_leds_release(find_lsb_set(m) - 1);
+    }
+    rtdb_leds_txn_commit(&upd->txn);
+}
+
+void rules_adc(uint16_t raw) {
+
+    if(rules_adc_mask == 0) {
+        return;
+    }
+
+    struct rules_update_t upd;
+    k_mutex_lock(&rules_lock, K_FOREVER);
+    rules_update_begin(&upd);
+    for(uint32_t m = rules_adc_mask; m; m &= m - 1) {
+        struct rule_t *rule = &rules[find_lsb_set(m) - 1];
+        rules_apply(rule, rules_adc_cond(rule, raw), &upd);
+    }
+    rules_update_commit(&upd);
+    k_mutex_unlock(&rules_lock);
+}
+
+void rules_buttons(uint32_t values) {
+
+    uint32_t mask = 0;
+    for(int i = 0; i < N_BUTTONS; i++) {
+        mask |= rules_button_mask[i];
+    }
+    if(mask == 0) {
+        return;
+    }
+
+    struct rules_update_t upd;
+    k_mutex_lock(&rules_lock, K_FOREVER);
+    rules_update_begin(&upd);
+    for(uint32_t m = mask; m; m &= m - 1) {
+        struct rule_t *rule = &rules[find_lsb_set(m) - 1];
+        rules_apply(rule, (values >> rule->button) & 1, &upd);
+    }
+    rules_update_commit(&upd);
+    k_mutex_unlock(&rules_lock);
+}
+
+void rules_event(uint8_t button, uint8_t type) {
+
+    if(button >= N_BUTTONS || rules_event_mask[button] == 0) {
+        return;
+    }
+
+    struct rules_update_t upd;
+    k_mutex_lock(&rules_lock, K_FOREVER);
+    rules_update_begin(&upd);
+    for(uint32_t m = rules_event_mask[button]; m; m &= m - 1) {
+        struct rule_t *rule = &rules[find_lsb_set(m) - 1];
+        if(rule->op == type) {
+            rules_apply(rule, true, &upd);
+        }
+    }
+    rules_update_commit(&upd);
+    k_mutex_unlock(&rules_lock);
+}
+
+/* Compiles a rule text, returns 0 or -EINVAL */
+static int rules_compile(const char *text, int len, struct rule_t *rule) {
+
+    int act;
+    memset(rule, 0, sizeof(*rule));
+    rule->state = -1;
+
+    if(len == 8 && text[0] == RULE_COND_ADC && (text[1] == RULE_ADC_ABOVE || text[1] == RULE_ADC_BELOW)) {
+        int mv = 0;
+        for(int i = 2; i < 6; i++) {
+            if(text[i] < '0' || text[i] > '9') {
+                return -EINVAL;
+            }
+            mv = mv * 10 + (text[i] - '0');
+        }
+        rule->op = text[1];
+        rule->level_mv = mv;
+        rule->level_raw = rules_level_raw(mv, rule->op == RULE_ADC_ABOVE);
+        act = 6;
+    } else if(len == 4 && text[0] == RULE_COND_BUTTON) {
+        rule->button = text[1] - '0';
+        act = 2;
+    } else if(len == 5 && text[0] == RULE_COND_EVENT && text[1] != '\0' &&
+              strchr(rules_event_letters, text[1]) != NULL) {
+        rule->op = strchr(rules_event_letters, text[1]) - rules_event_letters;
+        rule->button = text[2] - '0';
+        act = 3;
+    } else {
+        return -EINVAL;
+    }
+
+    rule->action = text[act];
+    rule->led = text[act + 1] - '0';
+    if(rule->button >= N_BUTTONS || rule->led >= N_LEDS || rule->action == '\0' ||
+       strchr("FISCT", rule->action) == NULL) {
+        return -EINVAL;
+    }
+    rule->cond = text[0];
+    return 0;
+}
+
+/* Removes a slot from the input masks, rules_lock must be held */
+static void rules_unlink(int slot) {
+    rules_adc_mask &= ~BIT(slot);
+    for(int i = 0; i < N_BUTTONS; i++) {
+        rules_button_mask[i] &= ~BIT(slot);
+        rules_event_mask[i] &= ~BIT(slot);
+    }
+    rules[slot].cond = 0;
+}
+
+int rules_set(int slot, const char *text, int len) {
+
+    struct rule_t rule;
+    if(slot < 0 || slot >= CONFIG_APP_RULES_MAX || rules_compile(text, len, &rule) != 0) {
+        return -EINVAL;
+    }
+
+    struct rules_update_t upd;
+    k_mutex_lock(&rules_lock, K_FOREVER);
+    rules_unlink(slot);
+    rules[slot] = rule;
+
+    /* A level rule takes effect now, not at the next change of its input */
+    rules_update_begin(&upd);
+    if(rule.cond == RULE_COND_ADC) {
+        int raw;
+        rtdb_read_adc_raw(&raw);
+        rules_apply(&rules[slot], rules_adc_cond(&rule, raw), &upd);
+        rules_adc_mask |= BIT(slot);
+    } else if(rule.cond == RULE_COND_BUTTON) {
+        int pressed;
+        rtdb_read_button(rule.button, &pressed);
+        rules_apply(&rules[slot], pressed, &upd);
+        rules_button_mask[rule.button] |= BIT(slot);
+    } else {
+        rules_event_mask[rule.button] |= BIT(slot);
+    }
+    rules_update_commit(&upd);
+
+    k_mutex_unlock(&rules_lock);
+    persist_touch(PERSIST_RULES);
+    return 0;
+}
+
+int rules_clear(int slot) {
+
+    if(slot < 0 || slot >= CONFIG_APP_RULES_MAX) {
+        return -EINVAL;
+    }
+    k_mutex_lock(&rules_lock, K_FOREVER);
+    rules_unlink(slot);
+    k_mutex_unlock(&rules_lock);
+    persist_touch(PERSIST_RULES);
+    return 0;
+}
+
+void rules_clear_all(void) {
+    k_mutex_lock(&rules_lock, K_FOREVER);
+    for(int i = 0; i < CONFIG_APP_RULES_MAX; i++) {
+        rules_unlink(i);
+    }
+    k_mutex_unlock(&rules_lock);
+    persist_touch(PERSIST_RULES);
+}
+
+int rules_get(int slot, struct rule_t *rule) {
+
+    if(slot < 0 || slot >= CONFIG_APP_RULES_MAX) {
+        return -EINVAL;
+    }
+    k_mutex_lock(&rules_lock, K_FOREVER);
+    *rule = rules[slot];
+    k_mutex_unlock(&rules_lock);
+    return rule->cond ? 0 : -ENOENT;
+}
+
+int rules_format(const struct rule_t *rule, char *buf) {
+    switch(rule->cond) {
+        case RULE_COND_ADC:
+            return snprintf(buf, RULE_TEXT_SIZE, "%c%c%04u%c%u", rule->cond, rule->op,
+                            (unsigned int)rule->level_mv, rule->action, (unsigned int)rule->led);
+        case RULE_COND_BUTTON:
+            return snprintf(buf, RULE_TEXT_SIZE, "%c%u%c%u", rule->cond, (unsigned int)rule->button,
+                            rule->action, (unsigned int)rule->led);
+        case RULE_COND_EVENT:
+            return snprintf(buf, RULE_TEXT_SIZE, "%c%c%u%c%u", rule->cond, rules_event_letters[rule->op],
+                            (unsigned int)rule->button, rule->action, (unsigned int)rule->led);
+        default:
+            buf[0] = '\0';
+            return 0;
+    }
+}
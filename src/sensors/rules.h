@@ -0,0 +1,158 @@
+/**
+ * @file rules.h
+ * @brief On-device reactive rules linking the inputs to the LEDs.
+ *
+ * This header file declares a small rules engine, enabled with
+ * CONFIG_APP_RULES, that drives LEDs from the ADC and the buttons without a
+ * host round trip. A rule is uploaded as text, compiled once into a fixed-size
+ * slot, and evaluated by the task that updates its input, right after the
+ * update. Each input keeps a mask of the rules that read it, so an input
+ * change only evaluates those rules, each in constant time, and every LED
+ * change they produce is committed as one RTDB transaction.
+ *
+ * Rule text, a condition then an action:
+ *
+ *     AH<dddd>  ADC at or above dddd mV
+ *     AL<dddd>  ADC at or below dddd mV
+ *     B<q>      button q pressed
+ *     E<e><q>   event e of button q: P press, R release, L long-press, D double-click
+ *
+ *     F<q>    LED q follows the condition (on while true, off while false)
+ *     I<q>    LED q follows the inverted condition
+ *     S<q>    LED q is set when the condition becomes true
+ *     C<q>    LED q is cleared when the condition becomes true
+ *     T<q>    LED q is toggled when the condition becomes true
+ *
+ * e.g. "AH2000F2" keeps LED 2 on while the ADC is above 2 V and "B0T0"
+ * toggles LED 0 on every press of button 0. Events are instantaneous, so on an
+ * 'E' condition 'F' acts as 'S' and 'I' as 'C'.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#ifndef __RULES_H__
+#define __RULES_H__
+
+#include <zephyr/kernel.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Conditions */
+#define RULE_COND_ADC 'A'
+#define RULE_COND_BUTTON 'B'
+#define RULE_COND_EVENT 'E'
+
+/* ADC comparisons */
+#define RULE_ADC_ABOVE 'H'
+#define RULE_ADC_BELOW 'L'
+
+/* Actions */
+#define RULE_ACT_FOLLOW 'F'
+#define RULE_ACT_INVERT 'I'
+#define RULE_ACT_SET 'S'
+#define RULE_ACT_CLEAR 'C'
+#define RULE_ACT_TOGGLE 'T'
+
+#define RULE_TEXT_SIZE 9        /* Longest rule text, terminator included */
+
+/**
+ * @struct rule_t
+ *
+ * @brief Compiled rule.
+ */
+struct rule_t {
+    uint8_t cond;           /* RULE_COND_*, 0 for an empty slot */
+    uint8_t op;             /* RULE_ADC_* for an ADC rule, event type (EVT_*) for an event rule */
+    uint8_t button;         /* Button of a button or event rule */
+    uint8_t action;         /* RULE_ACT_* */
+    uint8_t led;
+    int8_t state;           /* Last value of the condition, -1 before the first evaluation */
+    uint16_t level_mv;      /* ADC rule level, as uploaded */
+    uint16_t level_raw;     /* ADC rule level, as the raw sample it is compared to */
+    uint32_t fired;         /* Actions taken */
+};
+
+/**
+ * @brief Compiles a rule into a slot, replacing the rule it held.
+ *
+ * @param slot Slot (0 to CONFIG_APP_RULES_MAX - 1).
+ * @param text Rule text (see above).
+ * @param len Length of the text.
+ *
+ * @return int
+ * - Returns 0 on success.
+ * - Returns -EINVAL if the slot or the text is invalid.
+ */
+int rules_set(int slot, const char *text, int len);
+
+/**
+ * @brief Empties a slot.
+ *
+ * @param slot Slot (0 to CONFIG_APP_RULES_MAX - 1).
+ *
+ * @return int 0 on success, -EINVAL if the slot is invalid.
+ */
+int rules_clear(int slot);
+
+/**
+ * @brief Empties every slot.
+ */
+void rules_clear_all(void);
+
+/**
+ * @brief Gets the rule held by a slot.
+ *
+ * @param slot Slot (0 to CONFIG_APP_RULES_MAX - 1).
+ * @param rule Destination.
+ *
+ * @return int 0 on success, -EINVAL if the slot is invalid, -ENOENT if it is empty.
+ */
+int rules_get(int slot, struct rule_t *rule);
+
+/**
+ * @brief Formats a compiled rule back to its text.
+ *
+ * @param rule Rule.
+ * @param buf Destination, RULE_TEXT_SIZE bytes.
+ *
+ * @return int Length of the text.
+ */
+int rules_format(const struct rule_t *rule, char *buf);
+
+/* Hooks of the acquisition paths, no-ops without CONFIG_APP_RULES */
+#if defined(CONFIG_APP_RULES)
+
+/**
+ * @brief Evaluates the ADC rules on a new sample.
+ *
+ * @param raw Raw sample, as stored in the RTDB.
+ */
+void rules_adc(uint16_t raw);
+
+/**
+ * @brief Evaluates the button rules on new button states.
+ *
+ * @param values Button states (bit i set when button i is pressed).
+ */
+void rules_buttons(uint32_t values);
+
+/**
+ * @brief Evaluates the event rules of a button on one of its gestures.
+ *
+ * @param button Button.
+ * @param type Event type (EVT_PRESS, EVT_RELEASE, EVT_LONG_PRESS or EVT_DOUBLE_CLICK).
+ */
+void rules_event(uint8_t button, uint8_t type);
+
+#else
+
+static inline void rules_adc(uint16_t raw) { }
+static inline void rules_buttons(uint32_t values) { }
+static inline void rules_event(uint8_t button, uint8_t type) { }
+
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file main.c
+ * @brief Test suite of the command and sensor hot paths.
+ *
+ * Runs the checks and the benchmark of the '#Z' command (see selftest.h)
+ * under ztest, so that a failed check, or a benchmarked operation taking
+ * more than CONFIG_APP_SELFTEST_TOLERANCE % cycles over its baseline, fails
+ * the run:
+ *
+ *     west twister -T tests -p native_sim -p qemu_x86
+ *
+ * native_sim has no baseline, the benchmark only reports the host timings
+ * there. qemu_x86 runs with icount, the cycle counts are deterministic and
+ * checked against the baselines.
+ *
+ * The application modules are built without main(), nothing is started:
+ * the suites own the RTDB and the devices.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include <zephyr/ztest.h>
+#include "selftest.h"
+
+ZTEST_SUITE(selftest, NULL, NULL, NULL, NULL, NULL);
+
+ZTEST(selftest, test_checks) {
+    struct selftest_check_t checks[SELFTEST_MAX_CHECKS];
+    int n = selftest_checks(checks, SELFTEST_MAX_CHECKS);
+
+    zassert_true(n > 0, "no check group run");
+    for(int i = 0; i < n; i++) {
+        zassert_equal(checks[i].failures, 0, "%s: %d/%d failed, last: %s", checks[i].name,
+                      checks[i].failures, checks[i].total, checks[i].detail);
+    }
+}
+
+ZTEST(selftest, test_bench) {
+    struct selftest_bench_t bench[SELFTEST_MAX_BENCH];
+    int n = selftest_bench(bench, SELFTEST_MAX_BENCH);
+    int recorded = 0;
+
+    /* Printed first, the log is where the baselines are recorded from */
+    for(int i = 0; i < n; i++) {
+        TC_PRINT("%s: %u cycles (%u ns), baseline %u cycles\n", bench[i].name,
+                 (unsigned int)bench[i].cycles, (unsigned int)bench[i].ns,
+                 (unsigned int)bench[i].baseline_cycles);
+        recorded += bench[i].baseline_cycles != 0;
+    }
+    for(int i = 0; i < n; i++) {
+        zassert_false(bench[i].regressed, "%s regressed: %u cycles, baseline %u cycles + %d %%",
+                      bench[i].name, (unsigned int)bench[i].cycles, (unsigned int)bench[i].baseline_cycles,
+                      CONFIG_APP_SELFTEST_TOLERANCE);
+    }
+    if(recorded == 0) {
+        /* Timed, nothing to compare with (native_sim) */
+        ztest_test_skip();
+    }
+}
@@ -0,0 +1,50 @@
+/**
+ * @file test_leds.c
+ * @brief Binary LED control after the PWM engine (native_sim, emulated GPIO).
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include "leds.h"
+#include "pwm_leds.h"
+#include "rtdb.h"
+
+static const struct gpio_dt_spec led0_pin = GPIO_DT_SPEC_GET(LED0_NODE, gpios);
+
+/* LED 0 as seen on its pin */
+static bool led0_on(void) {
+    int level = gpio_emul_output_get(led0_pin.port, led0_pin.pin);
+    return (led0_pin.dt_flags & GPIO_ACTIVE_LOW) ? !level : level;
+}
+
+static void *leds_setup(void) {
+    zassert_equal(configure_leds(), 0, "LEDs not configured");
+    return NULL;
+}
+
+ZTEST_SUITE(leds, NULL, leds_setup, NULL, NULL, NULL);
+
+/* '#L01' then '#P0050' then '#L01': the last write must reach the pin */
+ZTEST(leds, test_binary_after_pwm) {
+    rtdb_set_led(0, 1);
+    task_led_set_code();
+    zassert_true(led0_on());
+
+    /* Both within one LED task period */
+    zassert_equal(pwm_leds_set_duty(0, 50), 0);
+
+    /* As the 'L' command: release, then write */
+    pwm_leds_release(0);
+    rtdb_set_led(0, 1);
+    task_led_set_code();
+    zassert_true(led0_on(), "LED 0 not driven after the PWM release");
+
+    rtdb_set_led(0, 0);
+    task_led_set_code();
+    zassert_false(led0_on());
+}
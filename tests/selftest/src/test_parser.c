@@ -0,0 +1,186 @@
+/**
+ * @file test_parser.c
+ * @brief Frame validator (validate_command) at the edge of every command form.
+ *
+ * For each opcode, every form is checked with the lowest and highest
+ * character of each class, with a character just outside a class at each
+ * position, one character short and one too many, and, for repeated classes,
+ * with 0, 1, 16 and 17 repetitions. The opcodes the POSIX regex accepted
+ * before the form table replaced it expect the results of that regex:
+ *
+ *   ^#(B[0-3]|L([0-3]|[0-3][0-1])|A(R|V)|E|G([LD][0-9]{4})?|P[0-3](0[0-9]{2}|100)?|
+ *   K[0-3][0-9]{4}|Q[0-3][01]{1,16}[0-9]{4}|J|T[A-Z]([0-9]{5})?|S[A-Z]R?|
+ *   D[A-Z]([0-9]{5}[SC])?|M|O[01]?|R[01]?|I|V([0-9][0-4])?|Z)
+ *   (2[5][0-5]|2[0-4][0-9]|[0-1][0-9]{2})!$
+ *
+ * The forms added since (LA, LM, H, C, Y, U, W) expect their entry in the
+ * command table of UART.c.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include <zephyr/ztest.h>
+#include <stdio.h>
+#include "UART.h"
+
+struct parser_case_t {
+    const char *cmd;
+    bool valid;
+};
+
+/* Opcodes of the regex, results of the regex */
+static const struct parser_case_t regex_cases[] = {
+    { "B", false }, { "B/", false }, { "B0", true }, { "B3", true }, { "B4", false }, { "B00", false },
+    { "B39", false }, { "L", false }, { "L/", false }, { "L0", true }, { "L3", true }, { "L4", false },
+    { "L@", false }, { "LB", false }, { "La", false }, { "L/0", false }, { "L0/", false }, { "L00", true },
+    { "L02", false }, { "L31", true }, { "L39", false }, { "L40", false }, { "LA0", false }, { "LA9", false },
+    { "L000", false }, { "L319", false }, { "LM0000000", false }, { "LL00000000", false },
+    { "LM/0000000", false }, { "LM0/000000", false }, { "LM00/00000", false }, { "LM000/0000", false },
+    { "LM0000/000", false }, { "LM00000/00", false }, { "LM000000/0", false }, { "LM0000000/", false },
+    { "LM00000002", false }, { "LM00000020", false }, { "LM00000200", false }, { "LM00002000", false },
+    { "LM00020000", false }, { "LM00200000", false }, { "LM02000000", false }, { "LM20000000", false },
+    { "LN00000000", false }, { "Lm00000000", false }, { "LM000000000", false }, { "LM111111119", false },
+    { "A", false }, { "A0", false }, { "AA", false }, { "AR", true }, { "AV", true }, { "Ar", false },
+    { "AR0", false }, { "AV9", false }, { "E", true }, { "E0", false }, { "E9", false }, { "G", true },
+    { "G0", false }, { "G9", false }, { "GL000", false }, { "GA0000", false }, { "GD9999", true },
+    { "GL/000", false }, { "GL0/00", false }, { "GL00/0", false }, { "GL000/", false }, { "GL0000", true },
+    { "GL000:", false }, { "GL00:0", false }, { "GL0:00", false }, { "GL:000", false }, { "Gl0000", false },
+    { "GD99999", false }, { "GL00000", false }, { "P", false }, { "P/", false }, { "P0", true },
+    { "P3", true }, { "P4", false }, { "P00", false }, { "P39", false }, { "P000", false }, { "P010", false },
+    { "P/000", false }, { "P/100", false }, { "P0/00", false }, { "P00/0", false }, { "P000/", false },
+    { "P0000", true }, { "P000:", false }, { "P00:0", false }, { "P01/0", false }, { "P010/", false },
+    { "P0100", true }, { "P0101", false }, { "P010x", false }, { "P0110", false }, { "P01x0", false },
+    { "P0200", false }, { "P0x00", false }, { "P3099", true }, { "P3100", true }, { "P4000", false },
+    { "P4100", false }, { "P00000", false }, { "P01000", false }, { "P30999", false }, { "P31009", false },
+    { "K", false }, { "K0", false }, { "K0000", false }, { "K/0000", false }, { "K0/000", false },
+    { "K00/00", false }, { "K000/0", false }, { "K0000/", false }, { "K00000", true }, { "K0000:", false },
+    { "K000:0", false }, { "K00:00", false }, { "K0:000", false }, { "K39999", true }, { "K40000", false },
+    { "K000000", false }, { "K399999", false }, { "Q", false }, { "Q0", false }, { "Q00000", false },
+    { "Q39999", false }, { "Q/00000", false }, { "Q0/0000", false }, { "Q00/000", false },
+    { "Q000/00", false }, { "Q0000/0", false }, { "Q00000/", false }, { "Q000000", true },
+    { "Q00000:", false }, { "Q0000:0", false }, { "Q000:00", false }, { "Q00:000", false },
+    { "Q020000", false }, { "Q319999", true }, { "Q400000", false }, { "Q0000000", true },
+    { "Q3199999", false }, { "Q00000000000000000000", true }, { "Q/00000000000000000000", false },
+    { "Q0////////////////0000", false }, { "Q00000000000000000/000", false },
+    { "Q000000000000000000/00", false }, { "Q0000000000000000000/0", false },
+    { "Q00000000000000000000/", false }, { "Q000000000000000000000", true },
+    { "Q00000000000000000000:", false }, { "Q0000000000000000000:0", false },
+    { "Q000000000000000000:00", false }, { "Q00000000000000000:000", false },
+    { "Q022222222222222220000", false }, { "Q311111111111111119999", true },
+    { "Q400000000000000000000", false }, { "Q0000000000000000000000", false },
+    { "Q3111111111111111119999", false }, { "Q3111111111111111199999", false }, { "J", true },
+    { "J0", false }, { "J9", false }, { "T", false }, { "T0", false }, { "T@", false }, { "TA", true },
+    { "TZ", true }, { "T[", false }, { "Ta", false }, { "TA0", false }, { "TZ9", false }, { "TA0000", false },
+    { "T@00000", false }, { "TA/0000", false }, { "TA0/000", false }, { "TA00/00", false },
+    { "TA000/0", false }, { "TA0000/", false }, { "TA00000", true }, { "TA0000:", false },
+    { "TA000:0", false }, { "TA00:00", false }, { "TA0:000", false }, { "TA:0000", false },
+    { "TZ99999", true }, { "T[00000", false }, { "Ta00000", false }, { "TA000000", false },
+    { "TZ999999", false }, { "S", false }, { "S0", false }, { "S@", false }, { "SA", true }, { "SZ", true },
+    { "S[", false }, { "Sa", false }, { "S@R", false }, { "SA0", false }, { "SAQ", false }, { "SAR", true },
+    { "SAS", false }, { "SAr", false }, { "SZ9", false }, { "SZR", true }, { "S[R", false }, { "SaR", false },
+    { "SAR0", false }, { "SZR9", false }, { "D", false }, { "D0", false }, { "D@", false }, { "DA", true },
+    { "DZ", true }, { "D[", false }, { "Da", false }, { "DA0", false }, { "DZ9", false },
+    { "DA00000", false }, { "D@00000S", false }, { "DA/0000S", false }, { "DA0/000S", false },
+    { "DA00/00S", false }, { "DA000/0S", false }, { "DA0000/S", false }, { "DA00000A", false },
+    { "DA00000S", true }, { "DA00000s", false }, { "DA0000:S", false }, { "DA000:0S", false },
+    { "DA00:00S", false }, { "DA0:000S", false }, { "DA:0000S", false }, { "DZ99999C", true },
+    { "D[00000S", false }, { "Da00000S", false }, { "DA00000S0", false }, { "DZ99999C9", false },
+    { "M", true }, { "M0", false }, { "M9", false }, { "O", true }, { "O/", false }, { "O0", true },
+    { "O1", true }, { "O2", false }, { "O9", false }, { "O00", false }, { "O19", false }, { "R", true },
+    { "R/", false }, { "R0", true }, { "R1", true }, { "R2", false }, { "R9", false }, { "R00", false },
+    { "R19", false }, { "I", true }, { "I0", false }, { "I9", false }, { "V", true }, { "V0", false },
+    { "V9", false }, { "V/0", false }, { "V0/", false }, { "V00", true }, { "V05", false }, { "V94", true },
+    { "V:0", false }, { "V000", false }, { "V949", false }, { "Z", true }, { "Z0", false }, { "Z9", false },
+};
+
+/* Forms added after the regex, results of the command table */
+static const struct parser_case_t later_cases[] = {
+    { "LA", true }, { "LM00000000", true }, { "LM11111111", true }, { "H", true }, { "H0", false },
+    { "H9", false }, { "HQ", false }, { "HR", true }, { "HS", false }, { "Hr", false }, { "HR0", false },
+    { "HR9", false }, { "C", true }, { "C0", false }, { "C9", false }, { "CC", false }, { "CD", true },
+    { "CE", false }, { "CR", false }, { "CS", true }, { "CT", true }, { "CU", false }, { "Cd", false },
+    { "Cs", false }, { "Ct", false }, { "CD0", false }, { "CD9", false }, { "CS0", false }, { "CS9", false },
+    { "CT0", false }, { "CT9", false }, { "CAH000", false }, { "C@H0000", false }, { "CAA0000", false },
+    { "CAC9999", true }, { "CAH/000", false }, { "CAH0/00", false }, { "CAH00/0", false },
+    { "CAH000/", false }, { "CAH0000", true }, { "CAH000:", false }, { "CAH00:0", false },
+    { "CAH0:00", false }, { "CAH:000", false }, { "CAh0000", false }, { "CBH0000", false },
+    { "CaH0000", false }, { "CAC99999", false }, { "CAH00000", false }, { "Y", true }, { "Y0", false },
+    { "Y9", false }, { "YC", false }, { "YD", true }, { "YE", true }, { "YF", false }, { "YO", false },
+    { "YP", true }, { "YQ", false }, { "YR", true }, { "YS", true }, { "YT", false }, { "Yd", false },
+    { "Ye", false }, { "Yp", false }, { "Yr", false }, { "Ys", false }, { "YD0", false }, { "YD9", false },
+    { "YE0", false }, { "YE9", false }, { "YP0", false }, { "YP9", false }, { "YR0", false },
+    { "YR9", false }, { "YS0", false }, { "YS9", false }, { "U", true }, { "U0", false }, { "U9", false },
+    { "UB", false }, { "UC", true }, { "UD", false }, { "Uc", false }, { "U/0", false }, { "U0/", false },
+    { "U00", true }, { "U0:", false }, { "U99", true }, { "U:0", false }, { "UC0", false }, { "UC9", false },
+    { "U000", false }, { "U999", false }, { "U00B0F", false }, { "U/0B0F0", false }, { "U0/B0F0", false },
+    { "U00A0F0", false }, { "U00B/F0", false }, { "U00B0A0", false }, { "U00B0F/", false },
+    { "U00B0F0", true }, { "U00B0F4", false }, { "U00B0f0", false }, { "U00B4F0", false },
+    { "U00C0F0", false }, { "U00EP0F", false }, { "U00b0F0", false }, { "U0:B0F0", false },
+    { "U99B3T3", true }, { "U:0B0F0", false }, { "U/0EP0F0", false }, { "U0/EP0F0", false },
+    { "U00B0F00", false }, { "U00DP0F0", false }, { "U00EA0F0", false }, { "U00EP/F0", false },
+    { "U00EP0A0", false }, { "U00EP0F/", false }, { "U00EP0F0", true }, { "U00EP0F4", false },
+    { "U00EP0f0", false }, { "U00EP4F0", false }, { "U00Ep0F0", false }, { "U00FP0F0", false },
+    { "U00eP0F0", false }, { "U0:EP0F0", false }, { "U99B3T39", false }, { "U99ED3T3", true },
+    { "U:0EP0F0", false }, { "U00EP0F00", false }, { "U99ED3T39", false }, { "U00AH0000F", false },
+    { "U00AL0000F", false }, { "U/0AH0000F0", false }, { "U/0AL0000F0", false }, { "U0/AH0000F0", false },
+    { "U0/AL0000F0", false }, { "U00@H0000F0", false }, { "U00@L0000F0", false }, { "U00AG0000F0", false },
+    { "U00AH/000F0", false }, { "U00AH0/00F0", false }, { "U00AH00/0F0", false }, { "U00AH000/F0", false },
+    { "U00AH0000A0", false }, { "U00AH0000F/", false }, { "U00AH0000F0", true }, { "U00AH0000F4", false },
+    { "U00AH0000f0", false }, { "U00AH000:F0", false }, { "U00AH00:0F0", false }, { "U00AH0:00F0", false },
+    { "U00AH:000F0", false }, { "U00AI0000F0", false }, { "U00AK0000F0", false }, { "U00AL/000F0", false },
+    { "U00AL0/00F0", false }, { "U00AL00/0F0", false }, { "U00AL000/F0", false }, { "U00AL0000A0", false },
+    { "U00AL0000F/", false }, { "U00AL0000F0", true }, { "U00AL0000F4", false }, { "U00AL0000f0", false },
+    { "U00AL000:F0", false }, { "U00AL00:0F0", false }, { "U00AL0:00F0", false }, { "U00AL:000F0", false },
+    { "U00AM0000F0", false }, { "U00Ah0000F0", false }, { "U00Al0000F0", false }, { "U00BH0000F0", false },
+    { "U00BL0000F0", false }, { "U00aH0000F0", false }, { "U00aL0000F0", false }, { "U0:AH0000F0", false },
+    { "U0:AL0000F0", false }, { "U99AH9999T3", true }, { "U99AL9999T3", true }, { "U:0AH0000F0", false },
+    { "U:0AL0000F0", false }, { "U00AH0000F00", false }, { "U00AL0000F00", false }, { "U99AH9999T39", false },
+    { "U99AL9999T39", false }, { "W", true }, { "W0", false }, { "W9", false }, { "WD", false },
+    { "WE", true }, { "WF", false }, { "WR", false }, { "WS", true }, { "WT", false }, { "We", false },
+    { "Ws", false }, { "WE0", false }, { "WE9", false }, { "WS0", false }, { "WS9", false },
+};
+
+/* Builds '#<cmd><checksum>!', the checksum value does not matter to the parser */
+static void parser_check(const struct parser_case_t *cases, int n) {
+    char frame[RXBUF_SIZE + 1];
+
+    for(int i = 0; i < n; i++) {
+        int sum = 0;
+        for(const char *c = cases[i].cmd; *c; c++) {
+            sum += *c;
+        }
+        snprintf(frame, sizeof(frame), "%c%s%03d%c", SOF_SYM, cases[i].cmd, sum % 256, EOF_SYM);
+        zassert_equal(validate_command(frame) == VALID_COMMAND, cases[i].valid, "%s: expected %s", frame,
+                      cases[i].valid ? "valid" : "invalid");
+    }
+}
+
+ZTEST_SUITE(parser, NULL, NULL, NULL, NULL, NULL);
+
+ZTEST(parser, test_regex_forms) {
+    parser_check(regex_cases, ARRAY_SIZE(regex_cases));
+}
+
+ZTEST(parser, test_later_forms) {
+    parser_check(later_cases, ARRAY_SIZE(later_cases));
+}
+
+ZTEST(parser, test_checksum_range) {
+    static const struct {
+        const char *frame;
+        bool valid;
+    } cases[] = {
+        { "#B0000!", true }, { "#B0199!", true }, { "#B0249!", true }, { "#B0250!", true },
+        { "#B0255!", true }, { "#B0256!", false }, { "#B0260!", false }, { "#B0300!", false },
+        { "#B0999!", false }, { "#B0 99!", false }, { "#B0-01!", false }, { "#B025!", false },
+    };
+    char frame[RXBUF_SIZE + 1];
+
+    for(int i = 0; i < ARRAY_SIZE(cases); i++) {
+        strcpy(frame, cases[i].frame);
+        zassert_equal(validate_command(frame) == VALID_COMMAND, cases[i].valid, "%s", cases[i].frame);
+    }
+}
@@ -0,0 +1,111 @@
+/**
+ * @file test_rtdb.c
+ * @brief RTDB write paths and LED transactions.
+ *
+ * These are the checks '#Z' cannot run on the live RTDB of the application.
+ *
+ * @author Diogo Lapa 117296
+ * @author Bruno Duarte 118326
+ * @date 04-06-2024
+ *
+ */
+
+#include <zephyr/ztest.h>
+#include "rtdb.h"
+
+static int listener_calls;
+static uint32_t listener_mask;
+
+static void test_listener(uint32_t mask) {
+    listener_calls++;
+    listener_mask = mask;
+}
+
+static void rtdb_before(void *fixture) {
+    struct rtdb_leds_txn_t txn;
+
+    rtdb_set_led_listener(NULL);
+    rtdb_leds_txn_begin(&txn);
+    for(int i = 0; i < 4; i++) {
+        rtdb_leds_txn_stage(&txn, i, 0);
+    }
+    rtdb_leds_txn_commit(&txn);
+    listener_calls = 0;
+    listener_mask = 0;
+}
+
+static void rtdb_after(void *fixture) {
+    rtdb_set_led_listener(NULL);
+}
+
+ZTEST_SUITE(rtdb, NULL, NULL, rtdb_before, rtdb_after, NULL);
+
+ZTEST(rtdb, test_adc) {
+    int value;
+
+    rtdb_set_adc_raw(1023);
+    rtdb_read_adc_raw(&value);
+    zassert_equal(value, 1023);
+    rtdb_set_adc_an(-1);
+    rtdb_read_adc_an(&value);
+    zassert_equal(value, -1);
+}
+
+ZTEST(rtdb, test_buttons) {
+    int value;
+
+    for(int i = 0; i < 4; i++) {
+        rtdb_set_button(i, i & 1);
+    }
+    for(int i = 0; i < 4; i++) {
+        rtdb_read_button(i, &value);
+        zassert_equal(value, i & 1, "button %d", i);
+    }
+}
+
+ZTEST(rtdb, test_led) {
+    int value;
+    uint32_t leds;
+
+    rtdb_set_led_listener(test_listener);
+    rtdb_set_led(3, 1);
+    rtdb_read_led(3, &value);
+    zassert_equal(value, 1);
+    rtdb_read_leds(&leds);
+    zassert_equal(leds, BIT(3));
+    zassert_equal(listener_calls, 1);
+    zassert_equal(listener_mask, BIT(3));
+}
+
+ZTEST(rtdb, test_leds_txn) {
+    struct rtdb_leds_txn_t txn;
+    uint32_t leds;
+
+    rtdb_set_led(1, 1);
+    rtdb_set_led_listener(test_listener);
+
+    /* Only the staged LEDs change, the last staged value wins */
+    rtdb_leds_txn_begin(&txn);
+    rtdb_leds_txn_stage(&txn, 0, 1);
+    rtdb_leds_txn_stage(&txn, 2, 0);
+    rtdb_leds_txn_stage(&txn, 2, 1);
+    rtdb_leds_txn_commit(&txn);
+    rtdb_read_leds(&leds);
+    zassert_equal(leds, BIT(0) | BIT(1) | BIT(2));
+
+    /* One listener call per transaction, with its mask */
+    zassert_equal(listener_calls, 1);
+    zassert_equal(listener_mask, BIT(0) | BIT(2));
+}
+
+ZTEST(rtdb, test_leds_txn_empty) {
+    struct rtdb_leds_txn_t txn;
+    uint32_t leds;
+
+    rtdb_set_led_listener(test_listener);
+    rtdb_leds_txn_begin(&txn);
+    rtdb_leds_txn_commit(&txn);
+    rtdb_read_leds(&leds);
+    zassert_equal(leds, 0);
+    zassert_equal(listener_calls, 0, "empty transaction notified");
+}
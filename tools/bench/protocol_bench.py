@@ -0,0 +1,389 @@
+#!/usr/bin/env python3
+"""
+Load generator and latency benchmark for the '#<cmd><checksum>!' UART protocol.
+
+Drives the firmware command processor through its UART, either the PTY that
+native_sim prints at start-up (e.g. /dev/pts/3) or a real serial port, and
+reports throughput, round-trip latency percentiles and error/drop rates.
+
+Frames are built as in validate_checksum(): the checksum is the sum of the
+command characters (between '#' and the checksum) modulo 256, written as
+three decimal digits.
+
+Every processed frame gets one response line (diagnostics go to a separate
+logging backend). The firmware serves LED writes in an urgent lane ahead of
+the other commands, so responses come in order within a lane but a LED write
+may overtake earlier reads. Latency is measured from the write of a frame to
+the reception of its response line. A frame without response within the
+timeout (or overtaken by the response of a later frame of the same lane)
+counts as dropped, a response that does not match the expected reply counts
+as an error.
+
+Examples:
+    # lock-step, 500 commands, default mix
+    ./protocol_bench.py /dev/pts/3 -n 500
+
+    # pipelined at 200 commands/s, up to 8 in flight, buttons and ADC only
+    ./protocol_bench.py /dev/ttyACM0 --mode pipelined --rate 200 --window 8 \\
+        --mix B=2,AR=1,AV=1 --duration 30
+
+    # regression gate, exits with 1 when a limit is exceeded
+    ./protocol_bench.py /dev/pts/3 -n 1000 --max-p99-ms 20 --max-drop-rate 0
+
+Only the Python standard library is used (POSIX termios).
+
+Authors: Diogo Lapa 117296, Bruno Duarte 118326
+"""
+
+import argparse
+import collections
+import json
+import os
+import random
+import re
+import select
+import sys
+import termios
+import threading
+import time
+import tty
+
+SOF = '#'
+EOF = '!'
+
+BAUDRATES = {
+    9600: termios.B9600,
+    19200: termios.B19200,
+    38400: termios.B38400,
+    57600: termios.B57600,
+    115200: termios.B115200,
+}
+
+# Expected response of each command kind, {0} is the LED/button index
+RESPONSES = {
+    'B': r'^BUTTON {0} STATUS: [01]$',
+    'LR': r'^LED {0} STATUS: [01]$',
+    'LW': r'^LED {0} STATUS CHANGED TO [01]$',
+    'AR': r'^ADC RAW: -?\d+$',
+    'AV': r'^ADC VAL: -?\d+$',
+}
+
+DEFAULT_MIX = 'B=1,LR=1,LW=1,AR=1,AV=1'
+
+# Firmware command lane of each kind (uart_command_lane())
+LANES = {'B': 'bulk', 'LR': 'bulk', 'LW': 'urgent', 'AR': 'bulk', 'AV': 'bulk'}
+
+
+def checksum(cmd):
+    """Checksum of the command characters, as computed by validate_checksum()."""
+    return sum(cmd.encode('ascii')) % 256
+
+
+def frame(cmd):
+    return '{}{}{:03d}{}'.format(SOF, cmd, checksum(cmd), EOF)
+
+
+def make_command(kind, rng):
+    """Returns (command, expected response regex) for a command kind."""
+    idx = rng.randrange(4)
+    if kind == 'B':
+        cmd = 'B{}'.format(idx)
+    elif kind == 'LR':
+        cmd = 'L{}'.format(idx)
+    elif kind == 'LW':
+        cmd = 'L{}{}'.format(idx, rng.randrange(2))
+    elif kind in ('AR', 'AV'):
+        cmd = kind
+    else:
+        raise ValueError(kind)
+    return cmd, re.compile(RESPONSES[kind].format(idx))
+
+
+def parse_mix(text):
+    mix = []
+    for item in text.split(','):
+        kind, _, weight = item.partition('=')
+        kind = kind.strip().upper()
+        if kind == 'L':
+            mix += [('LR', float(weight or 1) / 2), ('LW', float(weight or 1) / 2)]
+            continue
+        if kind not in RESPONSES:
+            raise argparse.ArgumentTypeError('unknown command kind: ' + kind)
+        mix.append((kind, float(weight or 1)))
+    return mix
+
+
+class Port:
+    """Raw, non-blocking access to a serial port or PTY."""
+
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        speed = BAUDRATES.get(baud)
+        if speed is None:
+            raise ValueError('unsupported baudrate {}'.format(baud))
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+
+    def write(self, data):
+        view = memoryview(data)
+        while view:
+            select.select([], [self.fd], [])
+            try:
+                n = os.write(self.fd, view)
+            except BlockingIOError:
+                continue
+            view = view[n:]
+
+    def read(self, timeout):
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        if not ready:
+            return b''
+        try:
+            return os.read(self.fd, 4096)
+        except BlockingIOError:
+            return b''
+
+    def close(self):
+        os.close(self.fd)
+
+
+class Request:
+    __slots__ = ('frame', 'expect', 'kind', 'sent')
+
+    def __init__(self, frame_, expect, kind, sent):
+        self.frame = frame_
+        self.expect = expect
+        self.kind = kind
+        self.sent = sent
+
+
+class Bench:
+
+    def __init__(self, port, args):
+        self.port = port
+        self.args = args
+        self.lock = threading.Condition()
+        self.pending = collections.deque()
+        self.latencies = collections.defaultdict(list)
+        self.sent = 0
+        self.ok = 0
+        self.errors = 0
+        self.drops = 0
+        self.stop = False
+
+    # --- receive side ----------------------------------------------------
+
+    def _expire(self, now):
+        """Drops requests without response within the timeout (lock held)."""
+        while self.pending and now - self.pending[0].sent > self.args.timeout:
+            self.pending.popleft()
+            self.drops += 1
+            self.lock.notify_all()
+
+    def _on_line(self, line, now):
+        with self.lock:
+            if not self.pending:
+                return
+            # Frames of the same lane sent before the one answered were lost
+            # by the firmware, frames of the other lane may still be queued
+            for req in self.pending:
+                if req.expect.match(line):
+                    lane = LANES[req.kind]
+                    kept = collections.deque()
+                    while True:
+                        head = self.pending.popleft()
+                        if head is req:
+                            break
+                        if LANES[head.kind] == lane:
+                            self.drops += 1
+                        else:
+                            kept.append(head)
+                    self.pending.extendleft(reversed(kept))
+                    self.ok += 1
+                    self.latencies[req.kind].append(now - req.sent)
+                    break
+            else:
+                req = self.pending.popleft()
+                self.errors += 1
+                if self.args.verbose:
+                    print('bad reply to {}: {!r}'.format(req.frame, line), file=sys.stderr)
+            self.lock.notify_all()
+
+    def reader(self):
+        buf = b''
+        while not self.stop:
+            data = self.port.read(0.01)
+            now = time.monotonic()
+            if data:
+                buf += data
+                while True:
+                    nl = buf.find(b'\n')
+                    if nl < 0:
+                        break
+                    line = buf[:nl].decode('ascii', 'replace').strip('\r\n\0 ')
+                    buf = buf[nl + 1:]
+                    if line:
+                        self._on_line(line, now)
+            with self.lock:
+                self._expire(now)
+
+    # --- send side -------------------------------------------------------
+
+    def run(self):
+        args = self.args
+        rng = random.Random(args.seed)
+        kinds = [k for k, _ in args.mix]
+        weights = [w for _, w in args.mix]
+        window = 1 if args.mode == 'lockstep' else args.window
+        interval = 1.0 / args.rate if args.rate > 0 else 0.0
+
+        rx = threading.Thread(target=self.reader, daemon=True)
+        rx.start()
+
+        start = time.monotonic()
+        next_send = start
+        while True:
+            now = time.monotonic()
+            if args.count and self.sent >= args.count:
+                break
+            if args.duration and now - start >= args.duration:
+                break
+
+            with self.lock:
+                while len(self.pending) >= window:
+                    self.lock.wait(0.05)
+
+            if interval:
+                delay = next_send - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+                next_send += interval
+
+            kind = rng.choices(kinds, weights)[0]
+            cmd, expect = make_command(kind, rng)
+            data = frame(cmd)
+            with self.lock:
+                self.pending.append(Request(data, expect, kind, time.monotonic()))
+                self.sent += 1
+            self.port.write(data.encode('ascii'))
+
+        # Wait for the replies still in flight
+        with self.lock:
+            while self.pending:
+                self.lock.wait(0.05)
+        elapsed = time.monotonic() - start
+        self.stop = True
+        rx.join()
+        return elapsed
+
+    # --- report ----------------------------------------------------------
+
+    def report(self, elapsed):
+        def percentiles(values):
+            if not values:
+                return {'n': 0}
+            values = sorted(values)
+
+            def pct(p):
+                return 1000.0 * values[min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))]
+            return {'n': len(values), 'p50_ms': pct(50), 'p99_ms': pct(99),
+                    'max_ms': 1000.0 * values[-1],
+                    'mean_ms': 1000.0 * sum(values) / len(values)}
+
+        all_lat = [v for vals in self.latencies.values() for v in vals]
+        by_lane = collections.defaultdict(list)
+        for kind, vals in self.latencies.items():
+            by_lane[LANES[kind]] += vals
+        sent = max(self.sent, 1)
+        return {
+            'mode': self.args.mode,
+            'sent': self.sent,
+            'ok': self.ok,
+            'errors': self.errors,
+            'drops': self.drops,
+            'error_rate': self.errors / sent,
+            'drop_rate': self.drops / sent,
+            'elapsed_s': elapsed,
+            'commands_per_s': self.ok / elapsed if elapsed else 0.0,
+            'latency': percentiles(all_lat),
+            'latency_by_kind': {k: percentiles(v) for k, v in sorted(self.latencies.items())},
+            'latency_by_lane': {k: percentiles(v) for k, v in sorted(by_lane.items())},
+        }
+
+
+def print_report(rep):
+    print('mode {mode}: sent {sent} ok {ok} errors {errors} drops {drops} in {elapsed_s:.2f} s'.format(**rep))
+    print('throughput: {:.1f} commands/s  error rate: {:.2%}  drop rate: {:.2%}'.format(
+        rep['commands_per_s'], rep['error_rate'], rep['drop_rate']))
+    print('{:<6} {:>6} {:>9} {:>9} {:>9} {:>9}'.format('kind', 'n', 'p50 ms', 'p99 ms', 'max ms', 'mean ms'))
+    rows = (list(rep['latency_by_kind'].items()) + list(rep['latency_by_lane'].items()) +
+            [('all', rep['latency'])])
+    for kind, lat in rows:
+        if not lat['n']:
+            print('{:<6} {:>6}'.format(kind, 0))
+            continue
+        print('{:<6} {:>6} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f}'.format(
+            kind, lat['n'], lat['p50_ms'], lat['p99_ms'], lat['max_ms'], lat['mean_ms']))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('port', help='serial port or PTY of the firmware UART')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--mode', choices=('lockstep', 'pipelined'), default='lockstep',
+                        help='wait for each reply, or keep up to --window frames in flight')
+    parser.add_argument('--window', type=int, default=4, help='frames in flight in pipelined mode')
+    parser.add_argument('--rate', type=float, default=0.0, help='offered load in commands/s (0: as fast as possible)')
+    parser.add_argument('--mix', type=parse_mix, default=parse_mix(DEFAULT_MIX),
+                        help='weighted command mix, kinds B, L (LR read + LW write), LR, LW, AR, AV '
+                             '(default {})'.format(DEFAULT_MIX))
+    parser.add_argument('-n', '--count', type=int, default=0, help='number of commands to send')
+    parser.add_argument('--duration', type=float, default=0.0, help='run time in seconds')
+    parser.add_argument('--timeout', type=float, default=1.0, help='reply timeout in seconds')
+    parser.add_argument('--settle', type=float, default=0.5, help='idle time before starting, to flush boot output')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--json', action='store_true', help='print the report as JSON')
+    parser.add_argument('--max-p99-ms', type=float, help='fail when the p99 latency exceeds this value')
+    parser.add_argument('--max-error-rate', type=float, help='fail when the error rate exceeds this value')
+    parser.add_argument('--max-drop-rate', type=float, help='fail when the drop rate exceeds this value')
+    parser.add_argument('--min-throughput', type=float, help='fail below this many commands/s')
+    parser.add_argument('-v', '--verbose', action='store_true')
+    args = parser.parse_args()
+
+    if not args.count and not args.duration:
+        args.count = 200
+
+    port = Port(args.port, args.baud)
+    try:
+        deadline = time.monotonic() + args.settle
+        while time.monotonic() < deadline:
+            port.read(0.05)
+        bench = Bench(port, args)
+        rep = bench.report(bench.run())
+    finally:
+        port.close()
+
+    if args.json:
+        print(json.dumps(rep, indent=2))
+    else:
+        print_report(rep)
+
+    failures = []
+    if args.max_p99_ms is not None and rep['latency'].get('p99_ms', float('inf')) > args.max_p99_ms:
+        failures.append('p99 latency above {} ms'.format(args.max_p99_ms))
+    if args.max_error_rate is not None and rep['error_rate'] > args.max_error_rate:
+        failures.append('error rate above {}'.format(args.max_error_rate))
+    if args.max_drop_rate is not None and rep['drop_rate'] > args.max_drop_rate:
+        failures.append('drop rate above {}'.format(args.max_drop_rate))
+    if args.min_throughput is not None and rep['commands_per_s'] < args.min_throughput:
+        failures.append('throughput below {} commands/s'.format(args.min_throughput))
+    for failure in failures:
+        print('FAIL: ' + failure, file=sys.stderr)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
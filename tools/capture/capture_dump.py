@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""
+Downloader and decoder of the triggered ADC capture ('#C' commands, CONFIG_APP_CAPTURE).
+
+Optionally arms the capture and waits for it to complete, then downloads the
+frozen capture from the firmware UART (or reads a dump saved earlier with
+--save), checks its CRC and writes the samples as CSV or prints a summary and
+a coarse text plot around the trigger.
+
+Block format: "CAPTURE BEGIN SAMPLES: <n> TRIGGER: <idx> INTERVAL: <us> us
+BYTES: <b>\\n", then <b> bytes holding the 10-bit samples packed 4 per 5
+bytes (little endian bit stream, oldest sample first), then
+"CAPTURE END CRC: <hex>\\n" with the CRC-16/CCITT (initial value 0xFFFF) of
+the packed bytes.
+
+Examples:
+    # arm on a rising edge through 1.5 V, wait, download to CSV
+    ./capture_dump.py --port /dev/pts/3 --arm R0512 --csv edge.csv
+
+    # download the capture triggered by button 1, keep the raw block
+    ./capture_dump.py --port /dev/ttyACM0 --arm B0001 --save b1.cap
+    ./capture_dump.py b1.cap --plot
+
+Authors: Diogo Lapa 117296, Bruno Duarte 118326
+"""
+
+import argparse
+import binascii
+import os
+import re
+import select
+import sys
+import termios
+import time
+import tty
+
+MV_FULL_SCALE = 3000
+RAW_FULL_SCALE = 1023
+
+
+def frame(cmd):
+    return '#{}{:03d}!'.format(cmd, sum(cmd.encode('ascii')) % 256).encode('ascii')
+
+
+class Port:
+
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[4] = attrs[5] = getattr(termios, 'B{}'.format(baud))
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+
+    def command(self, cmd, timeout, done):
+        """Sends a command and returns the reply once done(reply) or idle for timeout."""
+        os.write(self.fd, frame(cmd))
+        data = b''
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            ready, _, _ = select.select([self.fd], [], [], 0.1)
+            if ready:
+                data += os.read(self.fd, 65536)
+                deadline = time.monotonic() + timeout
+                if done(data):
+                    break
+        return data
+
+    def close(self):
+        os.close(self.fd)
+
+
+def line_done(data):
+    return data.endswith(b'\n')
+
+
+def parse_block(data, partial=False):
+    """Returns (trigger index, interval us, [samples]) or None if the block is incomplete."""
+    start = data.find(b'CAPTURE BEGIN')
+    if start < 0:
+        if partial:
+            return None
+        if b'CAPTURE NOT READY' in data:
+            raise ValueError('no frozen capture (arm it first)')
+        raise ValueError('no capture block found')
+    pos = data.find(b'\n', start)
+    if pos < 0:
+        return None
+    m = re.match(rb'CAPTURE BEGIN SAMPLES: (\d+) TRIGGER: (\d+) INTERVAL: (\d+) us BYTES: (\d+)', data[start:pos])
+    n, trigger, interval, n_bytes = (int(g) for g in m.groups())
+    pos += 1
+    end = data.find(b'\n', pos + n_bytes)
+    if len(data) < pos + n_bytes or end < 0:
+        if partial:
+            return None
+        raise ValueError('truncated block')
+    packed = data[pos:pos + n_bytes]
+    m = re.match(rb'CAPTURE END CRC: ([0-9A-F]{4})', data[pos + n_bytes:end])
+    if not m:
+        raise ValueError('missing CAPTURE END')
+    crc = binascii.crc_hqx(packed, 0xFFFF)
+    if crc != int(m.group(1), 16):
+        raise ValueError('CRC mismatch: block {} computed {:04X}'.format(m.group(1).decode(), crc))
+
+    samples = []
+    for i in range(0, n_bytes, 5):
+        bits = int.from_bytes(packed[i:i + 5], 'little')
+        samples += [(bits >> (10 * j)) & 0x3FF for j in range(4)]
+    return trigger, interval, samples[:n]
+
+
+def to_mv(raw):
+    return raw * MV_FULL_SCALE // RAW_FULL_SCALE
+
+
+def print_summary(trigger, interval, samples, plot):
+    mv = [to_mv(s) for s in samples]
+    print('{} samples every {} us ({:.1f} ms), trigger at sample {} ({} pre-trigger)'.format(
+        len(samples), interval, len(samples) * interval / 1000.0, trigger, trigger))
+    if not samples:
+        return
+    print('min {} mV  max {} mV  mean {:.0f} mV  at trigger {} mV'.format(
+        min(mv), max(mv), sum(mv) / len(mv), mv[trigger] if trigger < len(mv) else 0))
+    if not plot:
+        return
+    # One row per group of samples, min..max of the group, trigger row marked
+    rows, width = 32, 60
+    step = max(1, len(samples) // rows)
+    for i in range(0, len(samples), step):
+        group = mv[i:i + step]
+        lo = min(group) * width // MV_FULL_SCALE
+        hi = max(group) * width // MV_FULL_SCALE
+        mark = '>' if i <= trigger < i + step else ' '
+        t_ms = (i - trigger) * interval / 1000.0
+        print('{}{:>9.2f} ms |{}{}'.format(mark, t_ms, ' ' * lo, '#' * max(hi - lo, 1)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('file', nargs='?', help='saved block (omit with --port)')
+    parser.add_argument('--port', help='firmware UART (PTY or serial port)')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--arm', metavar='TLLLL',
+                        help="arm before downloading: trigger type (H, L, R, F, B, C) and 4-digit level or button")
+    parser.add_argument('--force', action='store_true', help='trigger the armed capture with a command')
+    parser.add_argument('--wait', type=float, default=30.0, help='max time waiting for the capture to complete (s)')
+    parser.add_argument('--timeout', type=float, default=2.0, help='idle time that ends a reply (s)')
+    parser.add_argument('--save', help='save the raw block to this file')
+    parser.add_argument('--csv', help='write index,time_ms,raw,mv rows to this file')
+    parser.add_argument('--plot', action='store_true', help='print a text plot')
+    args = parser.parse_args()
+
+    if args.port:
+        port = Port(args.port, args.baud)
+        try:
+            if args.arm:
+                reply = port.command('CA' + args.arm.upper(), args.timeout, line_done)
+                if b'CAPTURE STATE: ARMED' not in reply:
+                    print('arm failed: {!r}'.format(reply), file=sys.stderr)
+                    return 1
+            if args.force:
+                port.command('CT', args.timeout, line_done)
+            deadline = time.monotonic() + args.wait
+            while b'STATE: DONE' not in port.command('C', args.timeout, line_done):
+                if time.monotonic() > deadline:
+                    print('capture not complete after {} s'.format(args.wait), file=sys.stderr)
+                    return 1
+                time.sleep(0.2)
+            data = port.command('CD', args.timeout, lambda d: parse_block(d, partial=True) is not None)
+        finally:
+            port.close()
+    elif args.file:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+    else:
+        parser.error('give a block file or --port')
+
+    if args.save:
+        with open(args.save, 'wb') as f:
+            f.write(data)
+
+    trigger, interval, samples = parse_block(data)
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write('index,time_ms,raw,mv\n')
+            for i, raw in enumerate(samples):
+                f.write('{},{:.3f},{},{}\n'.format(i, (i - trigger) * interval / 1000.0, raw, to_mv(raw)))
+    print_summary(trigger, interval, samples, args.plot)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
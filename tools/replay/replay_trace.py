@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""
+Sensor trace tool for the replay source and recorder ('#Y' commands, CONFIG_APP_REPLAY).
+
+A trace has one record per line, '<t_ms> A <raw ADC value>' or
+'<t_ms> B <button states bitmask>', giving the value an input takes from
+t_ms on; lines starting with '#' are comments (see src/sensors/replay.h).
+
+Commands:
+    fetch   download the recording of the firmware ('#YD') to a trace file
+    table   convert a trace to the flash-resident table (replay_table.inc)
+    synth   generate a synthetic trace: ADC triangle wave and button presses
+    diff    compare two traces (e.g. the recordings of two firmware versions
+            replaying the same input), exits with 1 when they differ
+
+Examples:
+    ./replay_trace.py synth --duration-ms 20000 --press 1000:0:150 --press 5000:2:1500 -o in.trace
+    zephyr.exe --replay-file=in.trace --record-file=v1.trace --stop_at=25
+    ./replay_trace.py diff v1.trace v2.trace --tolerance-ms 1
+    ./replay_trace.py table in.trace -o ../../src/sensors/replay_table.inc
+    ./replay_trace.py fetch --port /dev/ttyACM0 board.trace
+
+default.trace is the source of the default table, its first line is the
+synth command that generated it.
+
+Authors: Diogo Lapa 117296, Bruno Duarte 118326
+"""
+
+import argparse
+import os
+import select
+import sys
+import termios
+import time
+import tty
+
+
+def frame(cmd):
+    return '#{}{:03d}!'.format(cmd, sum(cmd.encode('ascii')) % 256).encode('ascii')
+
+
+def parse(lines):
+    """Returns [(t_ms, input, value)], raises ValueError on a malformed line."""
+    recs = []
+    for n, line in enumerate(lines, 1):
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+        parts = line.split()
+        if len(parts) != 3 or parts[1] not in ('A', 'B'):
+            raise ValueError('line {}: expected "<t_ms> A|B <value>": {!r}'.format(n, line))
+        t, inp, value = int(parts[0]), parts[1], int(parts[2])
+        if recs and t < recs[-1][0]:
+            raise ValueError('line {}: records out of time order'.format(n))
+        if not 0 <= value <= (1023 if inp == 'A' else 0xFFFF):
+            raise ValueError('line {}: value out of range'.format(n))
+        recs.append((t, inp, value))
+    return recs
+
+
+def read(path):
+    with open(path) as f:
+        return parse(f)
+
+
+def write(path, recs, comment):
+    with open(path, 'w') if path != '-' else sys.stdout as f:
+        f.write('# {}\n'.format(comment))
+        for t, inp, value in recs:
+            f.write('{} {} {}\n'.format(t, inp, value))
+
+
+def cmd_fetch(args):
+    fd = os.open(args.port, os.O_RDWR | os.O_NOCTTY)
+    try:
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = getattr(termios, 'B{}'.format(args.baud))
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        termios.tcflush(fd, termios.TCIOFLUSH)
+        os.write(fd, frame('YD'))
+        data = b''
+        deadline = time.monotonic() + args.timeout
+        while time.monotonic() < deadline and b'REPLAY TRACE END' not in data:
+            ready, _, _ = select.select([fd], [], [], 0.1)
+            if ready:
+                data += os.read(fd, 65536)
+                deadline = time.monotonic() + args.timeout
+    finally:
+        os.close(fd)
+
+    text = data.decode('ascii', 'replace')
+    begin, end = text.find('REPLAY TRACE BEGIN'), text.find('REPLAY TRACE END')
+    if begin < 0 or end < 0:
+        print('no recording received', file=sys.stderr)
+        return 1
+    body = text[text.index('\n', begin) + 1:end]
+    footer = text[end:].splitlines()[0]
+    recs = parse(body.splitlines())
+    write(args.output, recs, 'recorded from {} ({})'.format(args.port, footer.strip()))
+    print('{} records'.format(len(recs)), file=sys.stderr)
+    return 0
+
+
+def cmd_table(args):
+    recs = read(args.trace)
+    with open(args.output, 'w') if args.output != '-' else sys.stdout as f:
+        f.write('/* Generated by tools/replay/replay_trace.py from {}, do not edit */\n'.format(
+            os.path.basename(args.trace)))
+        for t, inp, value in recs:
+            f.write("{{ .t_ms = {}, .value = {}, .input = '{}' }},\n".format(t, value, inp))
+    return 0
+
+
+def cmd_synth(args):
+    recs = []
+    # Triangle wave between --adc-min and --adc-max, one sample every --adc-step-ms
+    span = args.adc_max - args.adc_min
+    for t in range(0, args.duration_ms, args.adc_step_ms):
+        phase = (t % args.adc_period_ms) / args.adc_period_ms
+        level = 2 * phase if phase < 0.5 else 2 * (1 - phase)
+        recs.append((t, 'A', args.adc_min + int(round(span * level))))
+    # Button presses, given as t_ms:button:hold_ms
+    state = 0
+    edges = []
+    for press in args.press:
+        t, button, hold = (int(x) for x in press.split(':'))
+        edges += [(t, button, True), (t + hold, button, False)]
+    for t, button, down in sorted(edges):
+        state = state | (1 << button) if down else state & ~(1 << button)
+        recs.append((t, 'B', state))
+    recs.sort(key=lambda r: (r[0], r[1]))
+    write(args.output, recs, 'synthetic: {}'.format(' '.join(sys.argv[2:])))
+    return 0
+
+
+def cmd_diff(args):
+    a, b = read(args.a), read(args.b)
+    diffs = 0
+    for inp in ('A', 'B'):
+        ra = [r for r in a if r[1] == inp]
+        rb = [r for r in b if r[1] == inp]
+        for i in range(max(len(ra), len(rb))):
+            x = ra[i] if i < len(ra) else None
+            y = rb[i] if i < len(rb) else None
+            if x and y and x[2] == y[2] and abs(x[0] - y[0]) <= args.tolerance_ms:
+                continue
+            diffs += 1
+            if diffs <= args.max_report:
+                print('{} #{}: {} vs {}'.format(inp, i, x, y))
+    print('{} records vs {} records, {} differences'.format(len(a), len(b), diffs))
+    return 1 if diffs else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('fetch', help='download the firmware recording')
+    p.add_argument('output', help="trace file ('-' for stdout)")
+    p.add_argument('--port', required=True, help='firmware UART (PTY or serial port)')
+    p.add_argument('--baud', type=int, default=115200)
+    p.add_argument('--timeout', type=float, default=2.0, help='idle time that ends the download (s)')
+    p.set_defaults(func=cmd_fetch)
+
+    p = sub.add_parser('table', help='convert a trace to replay_table.inc')
+    p.add_argument('trace')
+    p.add_argument('-o', '--output', default='-')
+    p.set_defaults(func=cmd_table)
+
+    p = sub.add_parser('synth', help='generate a synthetic trace')
+    p.add_argument('-o', '--output', default='-')
+    p.add_argument('--duration-ms', type=int, default=10000)
+    p.add_argument('--adc-step-ms', type=int, default=100)
+    p.add_argument('--adc-period-ms', type=int, default=4000)
+    p.add_argument('--adc-min', type=int, default=0)
+    p.add_argument('--adc-max', type=int, default=1023)
+    p.add_argument('--press', action='append', default=[], metavar='T:BUTTON:HOLD',
+                   help='button press at T ms held for HOLD ms (repeatable)')
+    p.set_defaults(func=cmd_synth)
+
+    p = sub.add_parser('diff', help='compare two traces')
+    p.add_argument('a')
+    p.add_argument('b')
+    p.add_argument('--tolerance-ms', type=int, default=0, help='allowed time difference per record')
+    p.add_argument('--max-report', type=int, default=20, help='differences printed')
+    p.set_defaults(func=cmd_diff)
+
+    args = parser.parse_args()
+    try:
+        return args.func(args)
+    except ValueError as e:
+        print(e, file=sys.stderr)
+        return 2
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+"""
+Decoder of the binary event trace ('#R' command, CONFIG_APP_TRACE).
+
+Reads a trace dump, either straight from the firmware UART (the dump command
+is sent and the reply captured) or from a file saved earlier with --save, and
+prints per-stage latency histograms:
+
+    fifo wait   end of frame in uart_cb -> frame taken by the FIFO thread
+    parse       frame taken -> extracted and validated
+    execute     validated -> command executed and reply printed
+      rtdb        RTDB accesses made by the command (lock wait included)
+      reply       execute time not spent in the RTDB (mostly reply output)
+    end to end  end of frame -> reply printed
+
+and, per task run by the executive, the job execution time and the share of
+it spent in RTDB accesses.
+
+Dump format: "TRACE BEGIN CPUS: <n> HZ: <hz>\\n", then per CPU
+"TRACE CPU: <id> RECORDS: <n> LOST: <n>\\n" followed by <n> 8-byte little
+endian records (u32 timestamp, u8 event, u8 ctx, u16 arg), then "TRACE END\\n".
+
+Examples:
+    ./trace_decode.py --port /dev/pts/3 --save run1.trace
+    ./trace_decode.py run1.trace --events
+
+Authors: Diogo Lapa 117296, Bruno Duarte 118326
+"""
+
+import argparse
+import collections
+import os
+import re
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+
+EVT_UART_RX = 1
+EVT_CMD_DEQUEUE = 2
+EVT_CMD_PARSED = 3
+EVT_CMD_DONE = 4
+EVT_RTDB_LOCK = 5
+EVT_RTDB_UNLOCK = 6
+EVT_TASK_BEGIN = 7
+EVT_TASK_END = 8
+
+EVENT_NAMES = {
+    EVT_UART_RX: 'UART_RX', EVT_CMD_DEQUEUE: 'CMD_DEQUEUE', EVT_CMD_PARSED: 'CMD_PARSED',
+    EVT_CMD_DONE: 'CMD_DONE', EVT_RTDB_LOCK: 'RTDB_LOCK', EVT_RTDB_UNLOCK: 'RTDB_UNLOCK',
+    EVT_TASK_BEGIN: 'TASK_BEGIN', EVT_TASK_END: 'TASK_END',
+}
+RTDB_SIGNALS = ['ADC_RAW', 'ADC_AN', 'LED', 'BUTTON']
+RTDB_ALL = 0xFF
+CTX_ISR = 0x80
+REC = struct.Struct('<IBBH')
+
+Record = collections.namedtuple('Record', 'timestamp event ctx arg')
+
+
+def frame(cmd):
+    return '#{}{:03d}!'.format(cmd, sum(cmd.encode('ascii')) % 256).encode('ascii')
+
+
+def capture(port, baud, timeout):
+    """Sends the dump command and returns the raw reply."""
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+    try:
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = getattr(termios, 'B{}'.format(baud))
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        termios.tcflush(fd, termios.TCIOFLUSH)
+        os.write(fd, frame('R'))
+        data = b''
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            ready, _, _ = select.select([fd], [], [], 0.1)
+            if ready:
+                data += os.read(fd, 65536)
+                deadline = time.monotonic() + timeout
+                if parse_dump(data, partial=True) is not None:
+                    return data
+        return data
+    finally:
+        os.close(fd)
+
+
+def parse_dump(data, partial=False):
+    """Returns (hz, {cpu: (lost, [Record])}) or None if the dump is incomplete."""
+    start = data.find(b'TRACE BEGIN')
+    if start < 0:
+        if partial:
+            return None
+        raise ValueError('no trace dump found')
+    pos = data.find(b'\n', start)
+    if pos < 0:
+        return None
+    m = re.match(rb'TRACE BEGIN CPUS: (\d+) HZ: (\d+)', data[start:pos])
+    n_cpus, hz = int(m.group(1)), int(m.group(2))
+    pos += 1
+    rings = {}
+    for _ in range(n_cpus):
+        end = data.find(b'\n', pos)
+        if end < 0:
+            return None
+        m = re.match(rb'TRACE CPU: (\d+) RECORDS: (\d+) LOST: (\d+)', data[pos:end])
+        if not m:
+            raise ValueError('bad CPU header: {!r}'.format(data[pos:end]))
+        cpu, count, lost = (int(g) for g in m.groups())
+        pos = end + 1
+        if len(data) < pos + count * REC.size:
+            if partial:
+                return None
+            raise ValueError('truncated dump')
+        recs = [Record(*REC.unpack_from(data, pos + i * REC.size)) for i in range(count)]
+        pos += count * REC.size
+        rings[cpu] = (lost, recs)
+    if not data[pos:].startswith(b'TRACE END'):
+        if partial and len(data) - pos < len(b'TRACE END'):
+            return None
+        raise ValueError('missing TRACE END')
+    return hz, rings
+
+
+class Hist:
+    """Latency samples, reported with log2 buckets in us."""
+
+    def __init__(self):
+        self.samples = []
+
+    def add(self, us):
+        self.samples.append(us)
+
+    def print(self, name, width=40):
+        s = sorted(self.samples)
+        if not s:
+            print('{:<14} no samples'.format(name))
+            return
+
+        def pct(p):
+            return s[min(len(s) - 1, int(round(p / 100.0 * (len(s) - 1))))]
+        print('{:<14} n={:<6} min={:.1f} p50={:.1f} p99={:.1f} max={:.1f} us'.format(
+            name, len(s), s[0], pct(50), pct(99), s[-1]))
+        buckets = collections.Counter(0 if v < 1 else int(v).bit_length() for v in s)
+        top = max(buckets.values())
+        for b in range(min(buckets), max(buckets) + 1):
+            lo = 0 if b == 0 else 1 << (b - 1)
+            hi = 1 if b == 0 else 1 << b
+            n = buckets.get(b, 0)
+            print('    [{:>7}, {:>7}) us {:>6} {}'.format(lo, hi, n, '#' * max(n * width // top, 1 if n else 0)))
+
+
+def analyse(hz, rings, show_events=False):
+    mask = 0xFFFFFFFF
+
+    def us(a, b):
+        return ((b - a) & mask) * 1e6 / hz
+
+    # Single timeline, records of a ring are in reservation order
+    records = []
+    for cpu, (lost, recs) in sorted(rings.items()):
+        print('CPU {}: {} records, {} lost'.format(cpu, len(recs), lost))
+        records += recs
+    if len(rings) > 1:
+        base = records[0].timestamp if records else 0
+        records.sort(key=lambda r: (r.timestamp - base) & mask)
+
+    stages = collections.OrderedDict((k, Hist()) for k in
+                                     ('fifo wait', 'parse', 'execute', 'rtdb', 'reply', 'end to end'))
+    tasks = collections.defaultdict(lambda: (Hist(), Hist()))
+    cmds = {}
+    task_open = {}      # ctx -> (task id, begin timestamp, rtdb us)
+    rtdb_open = {}      # ctx -> lock timestamp
+    cmd_rtdb = collections.defaultdict(float)
+    current_cmd = None
+
+    for r in records:
+        if show_events:
+            arg = r.arg
+            if r.event in (EVT_RTDB_LOCK, EVT_RTDB_UNLOCK):
+                entry = r.arg & 0xFF
+                arg = '{}[{}] {}'.format(RTDB_SIGNALS[(r.arg >> 8) & 0x7F], '*' if entry == RTDB_ALL else entry,
+                                          'W' if r.arg & 0x8000 else 'R')
+            elif r.event in (EVT_TASK_BEGIN, EVT_TASK_END):
+                arg = chr(r.arg)
+            print('{:>10} cpu{}{} {:<12} {}'.format(r.timestamp, r.ctx & 0x7F, '*' if r.ctx & CTX_ISR else ' ',
+                                                 EVENT_NAMES.get(r.event, r.event), arg))
+        ctx = r.ctx & 0x7F
+        if r.event in (EVT_UART_RX, EVT_CMD_DEQUEUE, EVT_CMD_PARSED, EVT_CMD_DONE):
+            cmds.setdefault(r.arg, {})[r.event] = r.timestamp
+            if r.event == EVT_CMD_PARSED:
+                current_cmd = r.arg
+                cmd_rtdb[r.arg] = 0.0
+            elif r.event == EVT_CMD_DONE:
+                current_cmd = None
+        elif r.event == EVT_TASK_BEGIN:
+            task_open[ctx] = (r.arg, r.timestamp, 0.0)
+        elif r.event == EVT_TASK_END and ctx in task_open:
+            tid, begin, rtdb = task_open.pop(ctx)
+            exec_hist, rtdb_hist = tasks[chr(tid)]
+            exec_hist.add(us(begin, r.timestamp))
+            rtdb_hist.add(rtdb)
+        elif r.event == EVT_RTDB_LOCK:
+            rtdb_open[ctx] = r.timestamp
+        elif r.event == EVT_RTDB_UNLOCK and ctx in rtdb_open:
+            spent = us(rtdb_open.pop(ctx), r.timestamp)
+            # Tasks and commands run to completion on their thread, an access
+            # inside an open job window belongs to the task
+            if ctx in task_open:
+                tid, begin, rtdb = task_open[ctx]
+                task_open[ctx] = (tid, begin, rtdb + spent)
+            elif current_cmd is not None:
+                cmd_rtdb[current_cmd] += spent
+
+    for seq, ev in cmds.items():
+        if EVT_UART_RX in ev and EVT_CMD_DEQUEUE in ev:
+            stages['fifo wait'].add(us(ev[EVT_UART_RX], ev[EVT_CMD_DEQUEUE]))
+        if EVT_CMD_DEQUEUE in ev and EVT_CMD_PARSED in ev:
+            stages['parse'].add(us(ev[EVT_CMD_DEQUEUE], ev[EVT_CMD_PARSED]))
+        if EVT_CMD_PARSED in ev and EVT_CMD_DONE in ev:
+            execute = us(ev[EVT_CMD_PARSED], ev[EVT_CMD_DONE])
+            stages['execute'].add(execute)
+            stages['rtdb'].add(cmd_rtdb[seq])
+            stages['reply'].add(max(execute - cmd_rtdb[seq], 0.0))
+        if EVT_UART_RX in ev and EVT_CMD_DONE in ev:
+            stages['end to end'].add(us(ev[EVT_UART_RX], ev[EVT_CMD_DONE]))
+
+    print('\nCommands ({} frames)'.format(len(cmds)))
+    for name, hist in stages.items():
+        hist.print(name)
+    print('\nTasks')
+    for tid, (exec_hist, rtdb_hist) in sorted(tasks.items()):
+        exec_hist.print('task {} exec'.format(tid))
+        rtdb_hist.print('task {} rtdb'.format(tid))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('file', nargs='?', help='saved dump (omit with --port)')
+    parser.add_argument('--port', help='firmware UART (PTY or serial port) to dump the trace from')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--timeout', type=float, default=2.0, help='idle time that ends the capture (s)')
+    parser.add_argument('--save', help='save the raw dump to this file')
+    parser.add_argument('--events', action='store_true', help='print every record')
+    args = parser.parse_args()
+
+    if args.port:
+        data = capture(args.port, args.baud, args.timeout)
+    elif args.file:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+    else:
+        parser.error('give a dump file or --port')
+
+    if args.save:
+        with open(args.save, 'wb') as f:
+            f.write(data)
+
+    hz, rings = parse_dump(data)
+    analyse(hz, rings, args.events)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())